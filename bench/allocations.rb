@@ -0,0 +1,156 @@
+#
+# Allocation budgets for the binding's hot paths. Runs each call, and a
+# simulated frame loop, against the stub backend and fails if any allocates
+# more Ruby objects per call than its declared budget. Budgets are the most a
+# call may allocate on a 64-bit Ruby (where Floats are usually immediates);
+# lowering one is fine, raising one needs a good reason.
+#
+# Usage: ruby -I<extension dir> -Ilib bench/allocations.rb [--events COUNT]
+#
+# Prints one line per budget and exits non-zero if any budget was exceeded.
+# See bench/support.rb for building against the stub backend.
+#
+
+$LOAD_PATH.unshift(File.expand_path('..', __FILE__))
+require 'support'
+require 'optparse'
+
+events = 1000
+OptionParser.new { |opts|
+  opts.on('--events COUNT', Integer) { |count| events = count }
+}.parse!
+
+GlfwBench.require_stub!
+
+Glfw.init
+window = Glfw::Window.new(640, 480, 'allocations')
+window.make_context_current
+windows = [window, Glfw::Window.new(320, 240, 'allocations other', nil, window)]
+clock = Glfw::Clock.new(1.0 / 60.0)
+preset = Glfw::Window::HintPreset.new(Glfw::SAMPLES => 4, Glfw::RESIZABLE => false)
+pair = []
+snapshot = window.snapshot
+Glfw::Stub.set_joystick(0, 'Budget Pad', [0.0, 0.5, -0.5, 1.0], [0, 1, 0, 1])
+
+# Ignores its arguments without collecting them into an Array
+noop = proc { }
+%w[key char mouse_button cursor_position cursor_enter scroll position size
+   refresh focus iconify framebuffer_size].each { |type|
+  window.send("#{type}_callback=", noop)
+}
+
+queue_input = lambda { |count|
+  count.times { |index|
+    Glfw::Stub.post_event(window, :cursor_position, index.to_f, 1.0)
+    Glfw::Stub.post_event(window, :key, Glfw::KEY_A, 30, index.even? ? Glfw::PRESS : Glfw::RELEASE, 0)
+  }
+}
+
+# One frame of a typical loop, using the non-allocating forms of each call
+frame = lambda {
+  Glfw.poll_events
+  clock.tick
+  clock.alpha
+  window.get_cursor_pos_into(pair)
+  window.framebuffer_size_into(pair)
+  window.width
+  window.height
+  window.focused?
+  window.key(Glfw::KEY_A)
+  window.mouse_button(Glfw::MOUSE_BUTTON_LEFT)
+  Glfw.joystick_present?(0)
+  window.swap_buffers
+}
+
+#
+# Each budget is [name, allowed allocations per operation, op, options for
+# GlfwBench.allocations].
+#
+budgets = [
+  ["Glfw.poll_events (#{events} queued events, per event)", 0, lambda { Glfw.poll_events }, {
+    iterations: 1, per: events * 2, setup: lambda { queue_input.call(events) }
+  }],
+  ['Glfw.poll_events (no events)', 0, lambda { Glfw.poll_events }],
+  ['Glfw.await_events (no events, zero timeout)', 0, lambda { Glfw.await_events(0) }],
+  ['Glfw.await_events (one queued event)', 0, lambda { Glfw.await_events }, {
+    setup: lambda { Glfw::Stub.post_event(window, :refresh) }, iterations: 1
+  }],
+  ['Glfw.pump_events (active)', 0, lambda { Glfw.pump_events }, {
+    setup: lambda { Glfw.redraw_until(Glfw.time + 60.0) }
+  }],
+  ['Glfw.pump_events (idle, zero wait)', 0, lambda { Glfw.pump_events(0) }],
+  ['Glfw.time', 0, lambda { Glfw.time }],
+  ['Glfw.time_ns', 0, lambda { Glfw.time_ns }],
+  ['Glfw.joystick_present?', 0, lambda { Glfw.joystick_present?(0) }],
+  ['Glfw.joystick_axes', 1, lambda { Glfw.joystick_axes(0) }],
+  ['Glfw.joystick_buttons', 1, lambda { Glfw.joystick_buttons(0) }],
+  ['Glfw::Window#x', 0, lambda { window.x }],
+  ['Glfw::Window#y', 0, lambda { window.y }],
+  ['Glfw::Window#width', 0, lambda { window.width }],
+  ['Glfw::Window#height', 0, lambda { window.height }],
+  ['Glfw::Window#framebuffer_width', 0, lambda { window.framebuffer_width }],
+  ['Glfw::Window#framebuffer_height', 0, lambda { window.framebuffer_height }],
+  ['Glfw::Window#focused?', 0, lambda { window.focused? }],
+  ['Glfw::Window#iconified?', 0, lambda { window.iconified? }],
+  ['Glfw::Window#frame_due?', 0, lambda { window.frame_due? }],
+  ['Glfw::Window#get_should_close', 0, lambda { window.get_should_close }],
+  ['Glfw::Window#key', 0, lambda { window.key(Glfw::KEY_A) }],
+  ['Glfw::Window#mouse_button', 0, lambda { window.mouse_button(Glfw::MOUSE_BUTTON_LEFT) }],
+  ['Glfw::Window#get_position', 1, lambda { window.get_position }],
+  ['Glfw::Window#get_size', 1, lambda { window.get_size }],
+  ['Glfw::Window#framebuffer_size', 1, lambda { window.framebuffer_size }],
+  ['Glfw::Window#get_cursor_pos', 1, lambda { window.get_cursor_pos }],
+  ['Glfw::Window#get_position_into', 0, lambda { window.get_position_into(pair) }],
+  ['Glfw::Window#get_size_into', 0, lambda { window.get_size_into(pair) }],
+  ['Glfw::Window#framebuffer_size_into', 0, lambda { window.framebuffer_size_into(pair) }],
+  ['Glfw::Window#get_cursor_pos_into', 0, lambda { window.get_cursor_pos_into(pair) }],
+  ['Glfw::Window#snapshot (into)', 0, lambda { window.snapshot(snapshot) }],
+  ['Glfw::Window#make_context_current', 0, lambda { window.make_context_current }],
+  ['Glfw::Window#swap_buffers', 0, lambda { window.swap_buffers }],
+  ['Glfw::Window::HintPreset#apply', 0, lambda { preset.apply }, {
+    teardown: lambda { Glfw::Window.default_window_hints }
+  }],
+  ['Glfw::Window::HintPreset#[]', 0, lambda { preset[Glfw::SAMPLES] }],
+  ['Glfw::Window.pooled_count', 0, lambda { Glfw::Window.pooled_count }],
+  ['Glfw::Window.swap_all', 0, lambda { Glfw::Window.swap_all(windows) }],
+  ['Glfw::Clock#tick', 0, lambda { clock.tick }],
+  ['Glfw::Clock#alpha', 0, lambda { clock.alpha }],
+  ['frame loop (per frame)', 0, frame],
+  ["frame loop with #{events} queued events (per frame)", 0, frame, {
+    iterations: 1, setup: lambda { queue_input.call(events) }
+  }],
+  ['frame loop with instrumentation (per frame)', 0, frame, {
+    setup: lambda {
+      Glfw.frame_stats_enabled = true
+      Glfw.callback_stats_enabled = true
+      Glfw.input_latency_enabled = true
+      Glfw.start_trace(4096)
+      queue_input.call(10)
+    },
+    teardown: lambda {
+      Glfw.stop_trace
+      Glfw.input_latency_enabled = false
+      Glfw.callback_stats_enabled = false
+      Glfw.frame_stats_enabled = false
+    }
+  }],
+]
+
+failures = 0
+budgets.each { |name, budget, op, options|
+  allocations = GlfwBench.allocations(op, **(options || {}))
+  if allocations > budget
+    failures += 1
+    printf("FAIL %-60s %.2f allocs/op (budget %d)\n", name, allocations, budget)
+  else
+    printf("ok   %-60s %.2f allocs/op (budget %d)\n", name, allocations, budget)
+  end
+}
+
+window.destroy
+Glfw.terminate
+
+if failures > 0
+  puts "#{failures} of #{budgets.length} allocation budgets exceeded"
+  exit 1
+end
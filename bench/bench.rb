@@ -0,0 +1,381 @@
+#
+# Microbenchmarks for the binding's call and dispatch overhead. Measures
+# nanoseconds and object allocations per operation for every method the
+# extension defines, and per event for storms of each event type delivered
+# through poll_events to a Ruby callback.
+#
+# Usage: ruby -I<extension dir> -Ilib bench/bench.rb [options]
+#
+#     --format FORMAT   json (default) or text
+#     --filter REGEXP   only run benchmarks whose names match
+#     --time SECONDS    minimum time spent measuring each benchmark
+#     --events COUNT    events queued per poll in the event storms
+#
+# JSON output is a single object with the Ruby and GLFW versions, a "results"
+# array of { name, iterations, ns_per_op, allocs_per_op }, a "skipped" object
+# mapping methods left out on purpose to the reason why, and an "uncovered"
+# array naming native methods that have no benchmark, which should stay empty.
+# See bench/support.rb for building against the stub backend.
+#
+
+$LOAD_PATH.unshift(File.expand_path('..', __FILE__))
+require 'support'
+require 'json'
+require 'optparse'
+require 'tmpdir'
+
+options = { format: 'json', filter: nil, time: 0.05, events: 1000 }
+OptionParser.new { |opts|
+  opts.on('--format FORMAT', %w[json text]) { |format| options[:format] = format }
+  opts.on('--filter REGEXP', Regexp) { |filter| options[:filter] = filter }
+  opts.on('--time SECONDS', Float) { |time| options[:time] = time }
+  opts.on('--events COUNT', Integer) { |events| options[:events] = events }
+}.parse!
+
+GlfwBench.require_stub!
+
+Glfw.init
+Glfw::Window.default_window_hints
+
+window = Glfw::Window.new(640, 480, 'bench')
+other = Glfw::Window.new(320, 240, 'bench other', nil, window)
+window.make_context_current
+monitor = Glfw::Monitor.primary_monitor
+mode = monitor.video_mode
+ramp = monitor.get_gamma_ramp
+clock = Glfw::Clock.new(1.0 / 60.0)
+preset = Glfw::Window::HintPreset.new(Glfw::SAMPLES => 4, Glfw::RESIZABLE => false)
+pair = []
+snapshot = window.snapshot
+window.clipboard_string = 'bench'
+Glfw::Stub.set_joystick(0, 'Bench Pad', [0.0, 0.5, -0.5, 1.0], [0, 1, 0, 1])
+
+other_destroyed = Glfw::Window.new(64, 64, 'bench destroyed')
+other_destroyed.destroy
+
+trace_path = File::NULL
+recording_path = File.join(Dir.tmpdir, "glfw3-bench-#{$$}.events")
+Glfw.start_recording(recording_path)
+Glfw::Stub.post_event(window, :key, Glfw::KEY_A, 0, Glfw::PRESS, 0)
+Glfw::Stub.post_event(window, :key, Glfw::KEY_A, 0, Glfw::RELEASE, 0)
+window.key_callback = lambda { |*| }
+Glfw.poll_events
+window.key_callback = nil
+Glfw.stop_recording
+
+connected = []
+drain = lambda { Glfw.poll_events }
+# Ignores its arguments without collecting them into an Array
+noop = proc { }
+
+#
+# Each case is [name, op, options for GlfwBench.measure]. Names match those
+# from GlfwBench.native_methods, optionally followed by a note in parentheses.
+#
+cases = [
+  # Glfw
+  ['Glfw.version', lambda { Glfw.version }],
+  ['Glfw.init', lambda { Glfw.init }],
+  ['Glfw.poll_events', lambda { Glfw.poll_events }],
+  ['Glfw.wait_events (posting one event)', lambda {
+    Glfw::Stub.post_event(window, :refresh)
+    Glfw.wait_events
+  }],
+  ['Glfw.wait_events (posting an empty event)', lambda {
+    Glfw.post_empty_event
+    Glfw.wait_events
+  }],
+  ['Glfw.pump_events (active)', lambda { Glfw.pump_events }, {
+    setup: lambda { Glfw.redraw_until(Glfw.time + 60.0) }
+  }],
+  ['Glfw.pump_events (idle, zero wait)', lambda { Glfw.pump_events(0) }],
+  ['Glfw.redraw_until', lambda { Glfw.redraw_until(0.0) }],
+  ['Glfw.redraw_deadline', lambda { Glfw.redraw_deadline }],
+  ['Glfw.input_linger=', lambda { Glfw.input_linger = 0.25 }],
+  ['Glfw.input_linger', lambda { Glfw.input_linger }],
+  ['Glfw.post_empty_event', lambda { Glfw.post_empty_event }, { teardown: drain }],
+  ['Glfw.post_to_main', lambda { Glfw.post_to_main(&noop) }, { teardown: drain }],
+  ['Glfw.event_fd', lambda { Glfw.event_fd }],
+  ['Glfw.await_events (no events, zero timeout)', lambda { Glfw.await_events(0) }],
+  ['Glfw.await_events (posting one event)', lambda {
+    Glfw::Stub.post_event(window, :refresh)
+    Glfw.await_events
+  }],
+  ['Glfw.run (one frame)', lambda {
+    Glfw.run([other]) { |win, delta| win.should_close = true }
+    other.should_close = false
+  }, { batch: 100 }],
+  ['Glfw.time', lambda { Glfw.time }],
+  ['Glfw.time=', lambda { Glfw.time = 100.0 }],
+  ['Glfw.time_ns', lambda { Glfw.time_ns }],
+  ['Glfw.time_ns=', lambda { Glfw.time_ns = 100_000_000_000 }],
+  ['Glfw.timer_value', lambda { Glfw.timer_value }],
+  ['Glfw.timer_frequency', lambda { Glfw.timer_frequency }],
+  ['Glfw.swap_interval=', lambda { Glfw.swap_interval = 1 }],
+  ['Glfw.extension_supported?', lambda { Glfw.extension_supported?('GL_ARB_debug_output') }],
+  ['Glfw.joystick_present?', lambda { Glfw.joystick_present?(0) }],
+  ['Glfw.joystick_axes', lambda { Glfw.joystick_axes(0) }],
+  ['Glfw.joystick_buttons', lambda { Glfw.joystick_buttons(0) }],
+  ['Glfw.joystick_name', lambda { Glfw.joystick_name(0) }],
+  ['Glfw.frame_stats_enabled=', lambda { Glfw.frame_stats_enabled = false }],
+  ['Glfw.frame_stats_enabled?', lambda { Glfw.frame_stats_enabled? }],
+  ['Glfw.frame_stats', lambda { Glfw.frame_stats }, { batch: 100 }],
+  ['Glfw.reset_frame_stats', lambda { Glfw.reset_frame_stats }],
+  ['Glfw.callback_stats_enabled=', lambda { Glfw.callback_stats_enabled = false }],
+  ['Glfw.callback_stats_enabled?', lambda { Glfw.callback_stats_enabled? }],
+  ['Glfw.callback_stats', lambda { Glfw.callback_stats }, { batch: 100 }],
+  ['Glfw.reset_callback_stats', lambda { Glfw.reset_callback_stats }],
+  ['Glfw.input_latency_enabled=', lambda { Glfw.input_latency_enabled = false }],
+  ['Glfw.input_latency_enabled?', lambda { Glfw.input_latency_enabled? }],
+  ['Glfw.event_time_ns', lambda { Glfw.event_time_ns }],
+  ['Glfw.input_latency', lambda { Glfw.input_latency }, { batch: 100 }],
+  ['Glfw.reset_input_latency', lambda { Glfw.reset_input_latency }],
+  ['Glfw.start_trace', lambda { Glfw.start_trace(1024) }, { teardown: lambda { Glfw.stop_trace } }],
+  ['Glfw.stop_trace', lambda { Glfw.stop_trace }],
+  ['Glfw.tracing?', lambda { Glfw.tracing? }],
+  ['Glfw.write_trace (1024 spans)', lambda { Glfw.write_trace(trace_path) }, {
+    batch: 10,
+    setup: lambda {
+      Glfw.start_trace(1024)
+      1024.times { Glfw.poll_events }
+      Glfw.stop_trace
+    }
+  }],
+  ['Glfw.start_recording', lambda {
+    Glfw.start_recording(File::NULL)
+    Glfw.stop_recording
+  }, { batch: 100 }],
+  ['Glfw.stop_recording', lambda { Glfw.stop_recording }],
+  ['Glfw.recording?', lambda { Glfw.recording? }],
+  ['Glfw.replay_events (2 events)', lambda { Glfw.replay_events(recording_path, [window]) }, { batch: 100 }],
+
+  # Glfw::Window class methods
+  ['Glfw::Window.new (with #destroy)', lambda { Glfw::Window.new(64, 64, 'bench').destroy }, { batch: 100 }],
+  ['Glfw::Window.new (preset, with #destroy)', lambda {
+    Glfw::Window.new(64, 64, 'bench', nil, nil, preset).destroy
+  }, { batch: 100 }],
+  ['Glfw::Window.new (pooled, with #destroy)', lambda { Glfw::Window.new(64, 64, 'bench').destroy }, {
+    batch: 100,
+    setup: lambda { Glfw::Window.pool_limit = 1 },
+    teardown: lambda { Glfw::Window.pool_limit = 0 }
+  }],
+  ['Glfw::Window.pool_limit=', lambda { Glfw::Window.pool_limit = 0 }],
+  ['Glfw::Window.pool_limit', lambda { Glfw::Window.pool_limit }],
+  ['Glfw::Window.pooled_count', lambda { Glfw::Window.pooled_count }],
+  ['Glfw::Window.drain_pool (1 window)', lambda { Glfw::Window.drain_pool }, {
+    batch: 1,
+    setup: lambda {
+      Glfw::Window.pool_limit = 1
+      Glfw::Window.new(64, 64, 'bench pooled').destroy
+    },
+    teardown: lambda { Glfw::Window.pool_limit = 0 }
+  }],
+  ['Glfw::Window.window_hint', lambda { Glfw::Window.window_hint(Glfw::RESIZABLE, 1) }],
+  ['Glfw::Window.default_window_hints', lambda { Glfw::Window.default_window_hints }],
+  ['Glfw::Window::HintPreset.new (2 hints)', lambda {
+    Glfw::Window::HintPreset.new(Glfw::SAMPLES => 4, Glfw::RESIZABLE => false)
+  }],
+  ['Glfw::Window::HintPreset#apply (after default_window_hints)', lambda {
+    Glfw::Window.default_window_hints
+    preset.apply
+  }, { teardown: lambda { Glfw::Window.default_window_hints } }],
+  ['Glfw::Window::HintPreset#[]', lambda { preset[Glfw::SAMPLES] }],
+  ['Glfw::Window::HintPreset#to_h', lambda { preset.to_h }],
+  ['Glfw::Window.swap_all (2 windows)', lambda { Glfw::Window.swap_all([window, other]) }],
+  ['Glfw::Window.current_context', lambda { Glfw::Window.current_context }],
+  ['Glfw::Window.unset_context', lambda { Glfw::Window.unset_context }, {
+    teardown: lambda { window.make_context_current }
+  }],
+
+  # Glfw::Window
+  ['Glfw::Window#destroy (already destroyed)', lambda { other_destroyed.destroy }],
+  ['Glfw::Window#make_context_current (already current)', lambda { window.make_context_current }],
+  ['Glfw::Window#make_context_current (switching)', lambda {
+    other.make_context_current
+    window.make_context_current
+  }, { per: 2 }],
+  ['Glfw::Window#swap_buffers', lambda { window.swap_buffers }],
+  ['Glfw::Window#pace (deadline passed)', lambda { window.pace(1e9) }],
+  ['Glfw::Window#pause_when_hidden=', lambda { window.pause_when_hidden = false }],
+  ['Glfw::Window#pause_when_hidden?', lambda { window.pause_when_hidden? }],
+  ['Glfw::Window#unfocused_hz=', lambda { window.unfocused_hz = nil }],
+  ['Glfw::Window#unfocused_hz', lambda { window.unfocused_hz }],
+  ['Glfw::Window#throttled?', lambda { window.throttled? }],
+  ['Glfw::Window#frame_due?', lambda { window.frame_due? }],
+  ['Glfw::Window#hint_preset', lambda { window.hint_preset }],
+  ['Glfw::Window#needs_redraw?', lambda { window.needs_redraw? }],
+  ['Glfw::Window#mark_dirty', lambda { window.mark_dirty }],
+  ['Glfw::Window#render_on_demand=', lambda { window.render_on_demand = false }],
+  ['Glfw::Window#render_on_demand?', lambda { window.render_on_demand? }],
+  ['Glfw::Window#get_should_close', lambda { window.get_should_close }],
+  ['Glfw::Window#set_should_close', lambda { window.set_should_close(false) }],
+  ['Glfw::Window#title=', lambda { window.title = 'bench' }],
+  ['Glfw::Window#get_position', lambda { window.get_position }],
+  ['Glfw::Window#set_position', lambda { window.set_position(10, 20) }, { teardown: drain }],
+  ['Glfw::Window#get_size', lambda { window.get_size }],
+  ['Glfw::Window#set_size', lambda { window.set_size(640, 480) }, { teardown: drain }],
+  ['Glfw::Window#framebuffer_size', lambda { window.framebuffer_size }],
+  ['Glfw::Window#get_position_into', lambda { window.get_position_into(pair) }],
+  ['Glfw::Window#get_size_into', lambda { window.get_size_into(pair) }],
+  ['Glfw::Window#framebuffer_size_into', lambda { window.framebuffer_size_into(pair) }],
+  ['Glfw::Window#deferred_writes=', lambda { window.deferred_writes = false }],
+  ['Glfw::Window#deferred_writes?', lambda { window.deferred_writes? }],
+  ['Glfw::Window#flush_writes', lambda { window.flush_writes }],
+  ['Glfw::Window#x', lambda { window.x }],
+  ['Glfw::Window#y', lambda { window.y }],
+  ['Glfw::Window#width', lambda { window.width }],
+  ['Glfw::Window#height', lambda { window.height }],
+  ['Glfw::Window#framebuffer_width', lambda { window.framebuffer_width }],
+  ['Glfw::Window#framebuffer_height', lambda { window.framebuffer_height }],
+  ['Glfw::Window#focused?', lambda { window.focused? }],
+  ['Glfw::Window#iconified?', lambda { window.iconified? }],
+  ['Glfw::Window#refresh_cache', lambda { window.refresh_cache }],
+  ['Glfw::Window#snapshot', lambda { window.snapshot(snapshot) }],
+  ['Glfw::Window#iconify', lambda { window.iconify }, { teardown: drain }],
+  ['Glfw::Window#restore', lambda { window.restore }, {
+    setup: lambda { window.iconify; Glfw.poll_events },
+    teardown: drain
+  }],
+  ['Glfw::Window#show', lambda { window.show }],
+  ['Glfw::Window#hide', lambda { window.hide }, { teardown: lambda { window.show } }],
+  ['Glfw::Window#monitor', lambda { window.monitor }],
+  ['Glfw::Window#get_input_mode', lambda { window.get_input_mode(Glfw::CURSOR) }],
+  ['Glfw::Window#set_input_mode', lambda { window.set_input_mode(Glfw::CURSOR, Glfw::CURSOR_NORMAL) }],
+  ['Glfw::Window#key', lambda { window.key(Glfw::KEY_A) }],
+  ['Glfw::Window#mouse_button', lambda { window.mouse_button(Glfw::MOUSE_BUTTON_LEFT) }],
+  ['Glfw::Window#get_cursor_pos', lambda { window.get_cursor_pos }],
+  ['Glfw::Window#get_cursor_pos_into', lambda { window.get_cursor_pos_into(pair) }],
+  ['Glfw::Window#set_cursor_pos', lambda { window.set_cursor_pos(1.0, 2.0) }],
+  ['Glfw::Window#clipboard_string=', lambda { window.clipboard_string = 'bench' }],
+  ['Glfw::Window#clipboard_string', lambda { window.clipboard_string }],
+
+  # Glfw::Monitor
+  ['Glfw::Monitor.monitors', lambda { Glfw::Monitor.monitors }],
+  ['Glfw::Monitor.primary_monitor', lambda { Glfw::Monitor.primary_monitor }],
+  ['Glfw::Monitor#name', lambda { monitor.name }],
+  ['Glfw::Monitor#position', lambda { monitor.position }],
+  ['Glfw::Monitor#physical_size', lambda { monitor.physical_size }],
+  ['Glfw::Monitor#position_into', lambda { monitor.position_into(pair) }],
+  ['Glfw::Monitor#physical_size_into', lambda { monitor.physical_size_into(pair) }],
+  ['Glfw::Monitor#video_modes', lambda { monitor.video_modes }],
+  ['Glfw::Monitor#video_mode', lambda { monitor.video_mode }],
+  ['Glfw::Monitor#set_gamma', lambda { monitor.set_gamma(1.0) }, { batch: 100 }],
+  ['Glfw::Monitor#get_gamma_ramp', lambda { monitor.get_gamma_ramp }, { batch: 100 }],
+  ['Glfw::Monitor#set_gamma_ramp', lambda { monitor.set_gamma_ramp(ramp) }, { batch: 100 }],
+
+  # Glfw::VideoMode
+  ['Glfw::VideoMode#width', lambda { mode.width }],
+  ['Glfw::VideoMode#height', lambda { mode.height }],
+  ['Glfw::VideoMode#red_bits', lambda { mode.red_bits }],
+  ['Glfw::VideoMode#green_bits', lambda { mode.green_bits }],
+  ['Glfw::VideoMode#blue_bits', lambda { mode.blue_bits }],
+  ['Glfw::VideoMode#refresh_rate', lambda { mode.refresh_rate }],
+
+  # Glfw::Clock
+  ['Glfw::Clock.new', lambda { Glfw::Clock.new(1.0 / 60.0) }],
+  ['Glfw::Clock#tick', lambda { clock.tick }],
+  ['Glfw::Clock#alpha', lambda { clock.alpha }],
+  ['Glfw::Clock#step', lambda { clock.step }],
+  ['Glfw::Clock#total_steps', lambda { clock.total_steps }],
+  ['Glfw::Clock#pause', lambda { clock.pause }],
+  ['Glfw::Clock#resume', lambda { clock.resume }],
+  ['Glfw::Clock#paused?', lambda { clock.paused? }],
+  ['Glfw::Clock#reset', lambda { clock.reset }],
+
+  # Glfw::Stub
+  ['Glfw::Stub.post_event', lambda { Glfw::Stub.post_event(window, :refresh) }, { teardown: drain }],
+  ['Glfw::Stub.pending_events', lambda { Glfw::Stub.pending_events }],
+  ['Glfw::Stub.clock_rate=', lambda { Glfw::Stub.clock_rate = 1.0 }],
+  ['Glfw::Stub.advance_time', lambda { Glfw::Stub.advance_time(0.0) }],
+  ['Glfw::Stub.connect_monitor', lambda { connected << Glfw::Stub.connect_monitor('Bench', 800, 600) }, {
+    batch: 100,
+    teardown: lambda { connected.each { |monitor| Glfw::Stub.disconnect_monitor(monitor) }.clear }
+  }],
+  ['Glfw::Stub.disconnect_monitor', lambda { Glfw::Stub.disconnect_monitor(connected.pop) }, {
+    batch: 100,
+    setup: lambda { 100.times { connected << Glfw::Stub.connect_monitor('Bench', 800, 600) } }
+  }],
+  ['Glfw::Stub.set_joystick', lambda { Glfw::Stub.set_joystick(1, 'Bench Pad', [0.0], [1]) }],
+  ['Glfw::Stub.swap_count', lambda { Glfw::Stub.swap_count(window) }],
+  ['Glfw::Stub.strict_swap=', lambda { Glfw::Stub.strict_swap = false }],
+]
+
+# Callback setters, measured by enabling each one
+{
+  'set_window_position_callback__' => nil, 'set_window_size_callback__' => nil,
+  'set_close_callback__' => nil, 'set_refresh_callback__' => nil,
+  'set_focus_callback__' => nil, 'set_iconify_callback__' => nil,
+  'set_fbsize_callback__' => nil, 'set_key_callback__' => nil,
+  'set_char_callback__' => nil, 'set_mouse_button_callback__' => nil,
+  'set_cursor_position_callback__' => nil, 'set_cursor_enter_callback__' => nil,
+  'set_scroll_callback__' => nil
+}.each_key { |setter|
+  cases << ["Glfw::Window##{setter}", lambda { window.send(setter, true) }]
+}
+
+# Event storms: per-event cost of delivering queued events to a Ruby callback
+{
+  key: [Glfw::KEY_A, 30, Glfw::PRESS, 0],
+  char: [97],
+  mouse_button: [Glfw::MOUSE_BUTTON_LEFT, Glfw::PRESS, 0],
+  cursor_position: [10.5, 20.5],
+  cursor_enter: [true],
+  scroll: [0.0, 1.0],
+  position: [10, 20],
+  size: [640, 480],
+  close: [],
+  refresh: [],
+  focus: [true],
+  iconify: [false],
+  framebuffer_size: [640, 480]
+}.each { |type, args|
+  events = options[:events]
+  cases << ["event storm: #{type}", lambda { Glfw.poll_events }, {
+    batch: 1,
+    per: events,
+    setup: lambda {
+      window.send("#{type}_callback=", noop)
+      events.times { Glfw::Stub.post_event(window, type, *args) }
+    },
+    teardown: lambda {
+      window.send("#{type}_callback=", nil)
+      window.should_close = false
+    }
+  }]
+}
+
+# Methods deliberately left out, with the reason why
+skipped = {
+  'Glfw.terminate' => 'destroys every window and monitor the other benchmarks use'
+}
+
+covered = cases.map { |name, _| name.sub(/ \(.*\)\z/, '') }
+uncovered = GlfwBench.native_methods - covered - skipped.keys
+
+results = cases.select { |name, _|
+  options[:filter].nil? || options[:filter] =~ name
+}.map { |name, op, measure_options|
+  GlfwBench.measure(name, op, min_time: options[:time], **(measure_options || {}))
+}
+
+other.destroy
+window.destroy
+Glfw.terminate
+File.delete(recording_path) if File.exist?(recording_path)
+
+case options[:format]
+when 'json'
+  puts JSON.pretty_generate(
+    ruby: RUBY_DESCRIPTION,
+    glfw: Glfw.version.join('.'),
+    results: results.map(&:to_h),
+    skipped: skipped,
+    uncovered: uncovered
+  )
+when 'text'
+  width = results.map { |result| result.name.length }.max || 0
+  results.each { |result|
+    printf("%-*s %12.1f ns/op %8.2f allocs/op\n", width, result.name, result.ns_per_op, result.allocs_per_op)
+  }
+  puts "\nUncovered: #{uncovered.join(', ')}" unless uncovered.empty?
+end
@@ -0,0 +1,121 @@
+require 'glfw3'
+
+#
+# Shared helpers for the benchmarks in bench/. These need the extension built
+# against the headless stub backend (see README.md), which provides Glfw::Stub
+# for injecting events:
+#
+#     $ mkdir -p tmp/stub && cd tmp/stub
+#     $ ruby ../../ext/glfw3/extconf.rb --enable-stub
+#     $ make && make install sitearchdir=../lib
+#     $ cd ../.. && ruby -Itmp/lib -Ilib bench/bench.rb
+#
+module GlfwBench
+
+  # Result of measuring one operation.
+  Result = Struct.new(:name, :iterations, :ns_per_op, :allocs_per_op)
+
+  def self.require_stub!
+    unless defined?(Glfw::Stub)
+      abort "#{$0}: the glfw3 extension must be built with --enable-stub to run benchmarks"
+    end
+  end
+
+  def self.now_ns
+    Process.clock_gettime(Process::CLOCK_MONOTONIC, :nanosecond)
+  end
+
+  #
+  # Calls op in batches of +batch+ calls until at least +min_time+ seconds have
+  # been spent in it, and returns the mean nanoseconds and object allocations
+  # per operation. +setup+ and +teardown+ run untimed around each batch (e.g.,
+  # to queue events or drain ones the operation queued). If each call performs
+  # +per+ operations (e.g., one poll_events delivering +per+ events), results
+  # are per operation rather than per call.
+  #
+  def self.measure(name, op, setup: nil, teardown: nil, batch: 1000, per: 1, min_time: 0.05)
+    min_ns = (min_time * 1e9).to_i
+    elapsed = 0
+    allocated = 0
+    calls = 0
+
+    # Warm up (method caches, lazily allocated native state, etc.)
+    setup.call if setup
+    op.call
+    teardown.call if teardown
+    GC.start
+
+    while elapsed < min_ns
+      setup.call if setup
+      allocs_before = GC.stat(:total_allocated_objects)
+      time_before = now_ns
+      index = 0
+      while index < batch
+        op.call
+        index += 1
+      end
+      elapsed += now_ns - time_before
+      allocated += GC.stat(:total_allocated_objects) - allocs_before
+      calls += batch
+      teardown.call if teardown
+    end
+
+    ops = calls * per
+    Result.new(name, ops, elapsed.fdiv(ops), allocated.fdiv(ops))
+  end
+
+  #
+  # Calls op +iterations+ times and returns the mean number of objects
+  # allocated per operation, counting only the calls themselves. +setup+,
+  # +teardown+, and +per+ work the same as for ::measure, with setup and
+  # teardown run once around all of the calls.
+  #
+  # The count is the lowest of +runs+ runs, after a warm-up call, so one-off
+  # allocations (lazily allocated native state, the VM filling its method
+  # caches, etc.) aren't charged to the operation.
+  #
+  def self.allocations(op, iterations: 1000, setup: nil, teardown: nil, per: 1, runs: 3)
+    setup.call if setup
+    op.call
+    teardown.call if teardown
+
+    Array.new(runs) {
+      setup.call if setup
+      allocs_before = GC.stat(:total_allocated_objects)
+      index = 0
+      while index < iterations
+        op.call
+        index += 1
+      end
+      allocated = GC.stat(:total_allocated_objects) - allocs_before
+      teardown.call if teardown
+      allocated
+    }.min.fdiv(iterations * per)
+  end
+
+  #
+  # Names of every method implemented in C on the binding's classes and
+  # modules, as "Glfw.method", "Glfw::Window.method", or
+  # "Glfw::Window#method". Aliases are left out, since they share their
+  # original's implementation.
+  #
+  def self.native_methods
+    owners = [Glfw, Glfw::Window, Glfw::Window::HintPreset, Glfw::Monitor, Glfw::VideoMode,
+              Glfw::Clock]
+    owners << Glfw::Stub if defined?(Glfw::Stub)
+
+    owners.flat_map { |owner|
+      singleton = owner.singleton_methods(false).map { |name|
+        [owner.method(name), "#{owner}.#{name}"]
+      }
+      instance = owner.is_a?(Class) ?
+        (owner.instance_methods(false) + owner.private_instance_methods(false)).map { |name|
+          [owner.instance_method(name), "#{owner}##{name}"]
+        } : []
+      (singleton + instance).select { |method, _|
+        method.source_location.nil? && method.original_name == method.name
+      }.map { |_, label| label.sub(/#initialize\z/, '.new') }
+    }.sort
+  end
+
+end
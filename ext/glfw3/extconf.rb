@@ -1,6 +1,29 @@
 require 'mkmf'
 
-$LDFLAGS += " #{`pkg-config --static --libs glfw3`}"
-$CFLAGS += " #{`pkg-config --cflags glfw3`}"
+if enable_config('stub', false)
+  # Build against the bundled headless stub GLFW in ext/glfw3/stub instead of
+  # the system's, for testing and benchmarking without a display or GPU.
+  $srcs = %w[glfw3.c glfw_stub.c]
+  $VPATH << '$(srcdir)/stub'
+  $INCFLAGS << ' -I$(srcdir)/stub'
+  have_library('m', 'pow')
+else
+  # Stripped, since a trailing newline breaks the link commands mkmf's checks run
+  $LDFLAGS += " #{`pkg-config --static --libs glfw3`.strip}"
+  $CFLAGS += " #{`pkg-config --cflags glfw3`.strip}"
+
+  # Glfw.event_fd needs the X11 display connection, where GLFW uses X11. A
+  # GLFW built without X11 (e.g., Wayland only) doesn't export
+  # glfwGetX11Display, so check the linked library has it.
+  if RbConfig::CONFIG['host_os'] !~ /mswin|mingw|cygwin|darwin/ &&
+     have_header('X11/Xlib.h') && have_library('X11', 'XPending') &&
+     have_func('glfwGetX11Display', %w[X11/Xlib.h GLFW/glfw3.h GLFW/glfw3native.h],
+               '-DGLFW_EXPOSE_NATIVE_X11')
+    $defs << '-DRB_GLFW_X11'
+  end
+end
+
+# clock_gettime lives in librt on older glibc
+have_library('rt', 'clock_gettime')
 
 create_makefile('glfw3/glfw3')
@@ -1,5 +1,23 @@
 #include "ruby.h"
+#include "ruby/util.h"
+#include "ruby/thread.h"
+#include "ruby/io.h"
+#include <time.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
 #include <GLFW/glfw3.h>
+#if defined(RB_GLFW_X11) && !defined(GLFW_STUB)
+#define GLFW_EXPOSE_NATIVE_X11
+#include <GLFW/glfw3native.h>
+#endif
 
 void Init_glfw3(void);
 
@@ -24,6 +42,12 @@ static const char *kRB_CALL_NAME                                   = "call";
 static const char *kRB_RED_NAME                                    = "red";
 static const char *kRB_GREEN_NAME                                  = "green";
 static const char *kRB_BLUE_NAME                                   = "blue";
+static const char *kRB_POLL_NAME                                   = "poll";
+static const char *kRB_WAIT_NAME                                   = "wait";
+static const char *kRB_TARGET_FPS_NAME                             = "target_fps";
+static const char *kRB_REALTIME_NAME                               = "realtime";
+static const char *kRB_SLEEP_NAME                                  = "sleep";
+static const char *kRB_ADAPTIVE_NAME                               = "adaptive";
 
 
 static ID kRB_IVAR_WINDOW_INTERNAL;
@@ -47,6 +71,12 @@ static ID kRB_CALL;
 static ID kRB_RED;
 static ID kRB_GREEN;
 static ID kRB_BLUE;
+static ID kRB_POLL;
+static ID kRB_WAIT;
+static ID kRB_TARGET_FPS;
+static ID kRB_REALTIME;
+static ID kRB_SLEEP;
+static ID kRB_ADAPTIVE;
 
 
 static VALUE s_glfw_module = Qundef;
@@ -54,15 +84,471 @@ static VALUE s_glfw_window_klass = Qundef;
 static VALUE s_glfw_window_internal_klass = Qundef;
 static VALUE s_glfw_monitor_klass = Qundef;
 static VALUE s_glfw_videomode_klass = Qundef;
+static VALUE s_glfw_window_snapshot_klass = Qundef;
+static VALUE s_glfw_clock_klass = Qundef;
+static VALUE s_glfw_hint_preset_klass = Qundef;
+
+
+/* Member order of Glfw::Window::Snapshot, see rb_window_snapshot */
+enum {
+  kSNAPSHOT_SHOULD_CLOSE = 0,
+  kSNAPSHOT_X,
+  kSNAPSHOT_Y,
+  kSNAPSHOT_WIDTH,
+  kSNAPSHOT_HEIGHT,
+  kSNAPSHOT_FRAMEBUFFER_WIDTH,
+  kSNAPSHOT_FRAMEBUFFER_HEIGHT,
+  kSNAPSHOT_CURSOR_X,
+  kSNAPSHOT_CURSOR_Y,
+  kSNAPSHOT_CURSOR_MODE,
+  kSNAPSHOT_STICKY_KEYS,
+  kSNAPSHOT_STICKY_MOUSE_BUTTONS,
+  kSNAPSHOT_FOCUSED,
+  kSNAPSHOT_ICONIFIED
+};
+
+
+/*
+ * Window hints, which the binding tracks since GLFW 3.0 can't report them.
+ * Used to match requests for windows to pooled ones (see
+ * Glfw::Window.pool_limit=).
+ */
+enum {
+  kHINT_RESIZABLE = 0,
+  kHINT_VISIBLE,
+  kHINT_DECORATED,
+  kHINT_RED_BITS,
+  kHINT_GREEN_BITS,
+  kHINT_BLUE_BITS,
+  kHINT_ALPHA_BITS,
+  kHINT_DEPTH_BITS,
+  kHINT_STENCIL_BITS,
+  kHINT_ACCUM_RED_BITS,
+  kHINT_ACCUM_GREEN_BITS,
+  kHINT_ACCUM_BLUE_BITS,
+  kHINT_ACCUM_ALPHA_BITS,
+  kHINT_AUX_BUFFERS,
+  kHINT_STEREO,
+  kHINT_SAMPLES,
+  kHINT_SRGB_CAPABLE,
+  kHINT_REFRESH_RATE,
+  kHINT_CLIENT_API,
+  kHINT_CONTEXT_VERSION_MAJOR,
+  kHINT_CONTEXT_VERSION_MINOR,
+  kHINT_CONTEXT_ROBUSTNESS,
+  kHINT_OPENGL_FORWARD_COMPAT,
+  kHINT_OPENGL_DEBUG_CONTEXT,
+  kHINT_OPENGL_PROFILE,
+  kHINT_COUNT
+};
+
+/* GLFW's hint targets, in kHINT_* order */
+static const int kHINT_TARGETS[kHINT_COUNT] = {
+  GLFW_RESIZABLE, GLFW_VISIBLE, GLFW_DECORATED,
+  GLFW_RED_BITS, GLFW_GREEN_BITS, GLFW_BLUE_BITS, GLFW_ALPHA_BITS,
+  GLFW_DEPTH_BITS, GLFW_STENCIL_BITS,
+  GLFW_ACCUM_RED_BITS, GLFW_ACCUM_GREEN_BITS, GLFW_ACCUM_BLUE_BITS, GLFW_ACCUM_ALPHA_BITS,
+  GLFW_AUX_BUFFERS, GLFW_STEREO, GLFW_SAMPLES, GLFW_SRGB_CAPABLE, GLFW_REFRESH_RATE,
+  GLFW_CLIENT_API, GLFW_CONTEXT_VERSION_MAJOR, GLFW_CONTEXT_VERSION_MINOR,
+  GLFW_CONTEXT_ROBUSTNESS, GLFW_OPENGL_FORWARD_COMPAT, GLFW_OPENGL_DEBUG_CONTEXT,
+  GLFW_OPENGL_PROFILE
+};
+
+/* GLFW 3.0's defaults, as set by glfwDefaultWindowHints */
+static const int kHINT_DEFAULTS[kHINT_COUNT] = {
+  GL_TRUE, GL_TRUE, GL_TRUE,
+  8, 8, 8, 8,
+  24, 8,
+  0, 0, 0, 0,
+  0, GL_FALSE, 0, GL_FALSE, 0,
+  GLFW_OPENGL_API, 1, 0,
+  GLFW_NO_ROBUSTNESS, GL_FALSE, GL_FALSE,
+  GLFW_OPENGL_ANY_PROFILE
+};
+
+typedef struct rb_glfw_hints {
+  int values[kHINT_COUNT];
+  /* Serial of the Glfw::Window::HintPreset the values came from, or 0 */
+  uint32_t preset_id;
+  /* Whether hints outside kHINT_TARGETS were set too, so the values don't
+     fully describe the window */
+  int untracked;
+} rb_glfw_hints_t;
+
+/*
+ * Hints set with window_hint that aren't in kHINT_TARGETS (e.g., ones added
+ * after GLFW 3.0), so they can be set again after creating a window from a
+ * preset. Cleared along with GLFW's hints.
+ */
+typedef struct rb_glfw_extra_hint {
+  int target;
+  int value;
+} rb_glfw_extra_hint_t;
+
+enum { kHINT_MAX_EXTRAS = 32 };
+static rb_glfw_extra_hint_t s_extra_hints[kHINT_MAX_EXTRAS];
+static int s_extra_hint_count = 0;
+
+/* Serial of the last Glfw::Window::HintPreset created */
+static uint32_t s_hint_preset_serial = 0;
+
+/* The hints the next window will be created with */
+static rb_glfw_hints_t s_window_hints;
+
+/*
+ * Native per-window state. Owned by the window's Glfw::Window::InternalWindow
+ * object and reachable from its GLFWwindow through the window user pointer.
+ *
+ * The geometry, focus, and iconify fields are a cache of what the window
+ * system last reported through the window's callbacks, so reading them never
+ * allocates or queries the window system.
+ */
+typedef struct rb_glfw_window {
+  GLFWwindow *handle;
+  VALUE rb_window;
+  int x;
+  int y;
+  int width;
+  int height;
+  int fb_width;
+  int fb_height;
+  int focused;
+  int iconified;
+  int visible;
+
+  /* Deferred property writes, see Glfw::Window#deferred_writes= */
+  int deferred_writes;
+  int pending_writes;
+  char *title;
+  char *pending_title;
+  int applied_x;
+  int applied_y;
+  int applied_width;
+  int applied_height;
+  int pending_x;
+  int pending_y;
+  int pending_width;
+  int pending_height;
+  struct rb_glfw_window *next_pending;
+
+  /* Deadline for the next frame, see Glfw::Window#pace */
+  double pace_deadline;
+
+  /*
+   * Throttle policy, see Glfw::Window#pause_when_hidden= and #unfocused_hz=.
+   * throttle_deadline is when the window was last allowed a frame.
+   */
+  int pause_when_hidden;
+  double unfocused_hz;
+  double throttle_deadline;
+  /* When Glfw.run last yielded the window */
+  double last_frame_time;
+  /* The Glfw::Window.swap_all call that last swapped the window */
+  unsigned long swap_all_serial;
+
+  /* Damage tracking, see Glfw::Window#needs_redraw? */
+  int dirty;
+  int render_on_demand;
+
+  /* Allocated while frame stats are enabled, see Glfw.frame_stats */
+  struct rb_glfw_frame_stats *frame_stats;
+
+  /* Allocated while callback stats are enabled, see Glfw.callback_stats */
+  struct rb_glfw_callback_stats *callback_stats;
+
+  /* Input latency tracking, see Glfw.input_latency */
+  struct rb_glfw_input_latency *input_latency;
+  int64_t input_pending_since;
+  /*
+   * Id of the window in the current event recording. Ids are assigned from 1
+   * in creation order to windows open when recording starts or created while
+   * it's active.
+   */
+  uint32_t record_id;
+
+  /* What the window was created with, for returning it to the window pool */
+  rb_glfw_hints_t hints;
+  GLFWmonitor *monitor;
+  GLFWwindow *share;
+  int share_destroyed;
+} rb_glfw_window_t;
+
+
+/* Bits of rb_glfw_window_t.pending_writes */
+enum {
+  kPENDING_TITLE    = 1 << 0,
+  kPENDING_POSITION = 1 << 1,
+  kPENDING_SIZE     = 1 << 2,
+  kPENDING_QUEUED   = 1 << 3
+};
+
+
+/* Windows with deferred writes waiting for the next flush */
+static rb_glfw_window_t *s_pending_windows = NULL;
+
+
+/* Resets the tracked hints, as glfwDefaultWindowHints does GLFW's. */
+static void rb_glfw_reset_hints(void)
+{
+  MEMCPY(s_window_hints.values, kHINT_DEFAULTS, int, kHINT_COUNT);
+  s_window_hints.preset_id = 0;
+  s_window_hints.untracked = 0;
+  s_extra_hint_count = 0;
+}
+
+/*
+ * Resets GLFW's hints to their defaults, then sets the ones that differ in
+ * hints. Leaves s_extra_hints alone, so the caller decides whether they're
+ * cleared or set again.
+ */
+static void rb_glfw_apply_hints(const rb_glfw_hints_t *hints)
+{
+  int index = 0;
+  glfwDefaultWindowHints();
+  for (; index < kHINT_COUNT; ++index) {
+    if (hints->values[index] != kHINT_DEFAULTS[index]) {
+      glfwWindowHint(kHINT_TARGETS[index], hints->values[index]);
+    }
+  }
+  s_window_hints = *hints;
+}
+
+/* Records a hint outside kHINT_TARGETS set with window_hint. */
+static void rb_glfw_track_extra_hint(int target, int value)
+{
+  int index = 0;
+  for (; index < s_extra_hint_count; ++index) {
+    if (s_extra_hints[index].target == target) {
+      s_extra_hints[index].value = value;
+      return;
+    }
+  }
+  if (s_extra_hint_count < kHINT_MAX_EXTRAS) {
+    s_extra_hints[s_extra_hint_count].target = target;
+    s_extra_hints[s_extra_hint_count].value = value;
+    ++s_extra_hint_count;
+  }
+}
+
+/* Returns the kHINT_* index of a GLFW hint target, or -1 if it's unknown. */
+static int rb_glfw_hint_index(int target)
+{
+  int index = 0;
+  for (; index < kHINT_COUNT; ++index) {
+    if (kHINT_TARGETS[index] == target) {
+      return index;
+    }
+  }
+  return -1;
+}
+
+/*
+ * Returns whether windows created with either set of hints are
+ * interchangeable. Visibility doesn't count, since pooled windows are hidden
+ * and shown again as needed.
+ */
+static int rb_glfw_hints_match(const rb_glfw_hints_t *a, const rb_glfw_hints_t *b)
+{
+  int index = 0;
+  if (a->untracked || b->untracked) {
+    return 0;
+  }
+  if (a->preset_id != 0 && a->preset_id == b->preset_id) {
+    return 1;
+  }
+  for (; index < kHINT_COUNT; ++index) {
+    if (index != kHINT_VISIBLE && a->values[index] != b->values[index]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+
+/*
+ * Hidden windows kept for reuse by Glfw::Window.new after Glfw::Window#destroy,
+ * most recently pooled first. See Glfw::Window.pool_limit=.
+ */
+typedef struct rb_glfw_pooled_window {
+  GLFWwindow *handle;
+  GLFWwindow *share;
+  rb_glfw_hints_t hints;
+  struct rb_glfw_pooled_window *next;
+} rb_glfw_pooled_window_t;
+
+static rb_glfw_pooled_window_t *s_window_pool = NULL;
+static long s_window_pool_count = 0;
+static long s_window_pool_limit = 0;
+
+/* Marks a live window as sharing with a destroyed window. */
+static int rb_window_forget_share_i(VALUE key, VALUE rb_window, VALUE arg)
+{
+  VALUE rb_window_data = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_INTERNAL);
+  rb_glfw_window_t *state = NULL;
+  if (RTEST(rb_window_data)) {
+    Data_Get_Struct(rb_window_data, rb_glfw_window_t, state);
+    if (state->share == (GLFWwindow *)arg) {
+      state->share_destroyed = 1;
+    }
+  }
+  return ST_CONTINUE;
+}
+
+/*
+ * Destroys a window for real. Since its address may be reused by an unrelated
+ * window, pooled windows keyed to it as their share window are destroyed too,
+ * and live ones sharing with it won't be pooled.
+ */
+static void rb_window_pool_destroy(GLFWwindow *window)
+{
+  rb_glfw_pooled_window_t **link = &s_window_pool;
+
+  glfwDestroyWindow(window);
+  rb_hash_foreach(rb_cvar_get(s_glfw_window_klass, kRB_CVAR_WINDOW_WINDOWS),
+                  rb_window_forget_share_i, (VALUE)window);
+
+  while (*link) {
+    rb_glfw_pooled_window_t *entry = *link;
+    if (entry->share == window) {
+      *link = entry->next;
+      --s_window_pool_count;
+      rb_window_pool_destroy(entry->handle);
+      xfree(entry);
+      /* The recursive call may have removed entries after this one */
+      link = &s_window_pool;
+    } else {
+      link = &entry->next;
+    }
+  }
+}
+
+/* Destroys pooled windows, least recently pooled first, down to limit. */
+static void rb_window_pool_trim(long limit)
+{
+  while (s_window_pool_count > limit) {
+    rb_glfw_pooled_window_t **link = &s_window_pool;
+    rb_glfw_pooled_window_t *entry = NULL;
+    while ((*link)->next) {
+      link = &(*link)->next;
+    }
+    entry = *link;
+    *link = NULL;
+    --s_window_pool_count;
+    rb_window_pool_destroy(entry->handle);
+    xfree(entry);
+  }
+}
+
+/* Forgets pooled windows without destroying them, for after glfwTerminate. */
+static void rb_window_pool_forget(void)
+{
+  while (s_window_pool) {
+    rb_glfw_pooled_window_t *entry = s_window_pool;
+    s_window_pool = entry->next;
+    xfree(entry);
+  }
+  s_window_pool_count = 0;
+}
+
+/*
+ * Detaches the window from its Glfw::Window, resets it, and pools it, if it's
+ * eligible and the pool has room. Returns whether it was pooled.
+ */
+static int rb_window_pool_put(rb_glfw_window_t *state)
+{
+  GLFWwindow *window = state->handle;
+  rb_glfw_pooled_window_t *entry = NULL;
+
+  if (s_window_pool_count >= s_window_pool_limit || state->monitor != NULL ||
+      state->share_destroyed) {
+    return 0;
+  }
+
+  if (glfwGetCurrentContext() == window) {
+    glfwMakeContextCurrent(NULL);
+  }
+  glfwHideWindow(window);
+  glfwSetWindowShouldClose(window, GL_FALSE);
+  glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+  glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_FALSE);
+  glfwSetInputMode(window, GLFW_STICKY_MOUSE_BUTTONS, GL_FALSE);
+  glfwSetKeyCallback(window, NULL);
+  glfwSetCharCallback(window, NULL);
+  glfwSetMouseButtonCallback(window, NULL);
+  glfwSetCursorPosCallback(window, NULL);
+  glfwSetCursorEnterCallback(window, NULL);
+  glfwSetScrollCallback(window, NULL);
+  glfwSetWindowPosCallback(window, NULL);
+  glfwSetWindowSizeCallback(window, NULL);
+  glfwSetWindowCloseCallback(window, NULL);
+  glfwSetWindowRefreshCallback(window, NULL);
+  glfwSetWindowFocusCallback(window, NULL);
+  glfwSetWindowIconifyCallback(window, NULL);
+  glfwSetFramebufferSizeCallback(window, NULL);
+  glfwSetWindowUserPointer(window, NULL);
+
+  entry = ALLOC(rb_glfw_pooled_window_t);
+  entry->handle = window;
+  entry->share = state->share;
+  entry->hints = state->hints;
+  entry->next = s_window_pool;
+  s_window_pool = entry;
+  ++s_window_pool_count;
+  return 1;
+}
+
+/*
+ * Takes a pooled window created with matching hints and share window out of
+ * the pool, or returns NULL if there isn't one.
+ */
+static GLFWwindow *rb_window_pool_take(GLFWwindow *share, const rb_glfw_hints_t *hints)
+{
+  rb_glfw_pooled_window_t **link = &s_window_pool;
+
+  for (; *link; link = &(*link)->next) {
+    rb_glfw_pooled_window_t *entry = *link;
+    if (entry->share == share && rb_glfw_hints_match(&entry->hints, hints)) {
+      GLFWwindow *window = entry->handle;
+      *link = entry->next;
+      --s_window_pool_count;
+      xfree(entry);
+      return window;
+    }
+  }
+  return NULL;
+}
 
 
 static void rb_glfw_error_callback(int error_code, const char *description);
 static void rb_glfw_monitor_callback(GLFWmonitor *monitor, int message);
+static void rb_window_window_position_callback(GLFWwindow *window, int x, int y);
+static void rb_window_window_size_callback(GLFWwindow *window, int width, int height);
+static void rb_window_refresh_callback(GLFWwindow *window);
+static void rb_window_focus_callback(GLFWwindow *window, int focused);
+static void rb_window_iconify_callback(GLFWwindow *window, int iconified);
+static void rb_window_fbsize_callback(GLFWwindow *window, int width, int height);
+static double rb_glfw_next_wake_time(void);
 
 
 #define Q_IS_A(OBJ, KLASS) RTEST(rb_obj_is_kind_of((OBJ), (KLASS)))
 
 
+/*
+ * Writes a pair of values into the first two elements of a caller-supplied
+ * array, for the *_into variants of getters that would otherwise allocate a new
+ * array per call. Returns the array.
+ */
+static VALUE rb_store_pair(VALUE rb_ary, VALUE first, VALUE second)
+{
+  if (!Q_IS_A(rb_ary, rb_cArray)) {
+    rb_raise(rb_eArgError, "Output must be an Array");
+  }
+  rb_ary_store(rb_ary, 0, first);
+  rb_ary_store(rb_ary, 1, second);
+  return rb_ary;
+}
+
+
 #define RB_ENABLE_CALLBACK_DEF(NAME, CALLBACK, GLFW_FUNC)                     \
 static VALUE NAME (VALUE self, VALUE enabled)                                 \
 {                                                                             \
@@ -75,6 +561,334 @@ static VALUE NAME (VALUE self, VALUE enabled)                                 \
 }
 
 
+/*
+ * Like RB_ENABLE_CALLBACK_DEF, but for callbacks that also keep the window's
+ * cached state up to date. Those are installed when the window is created and
+ * never removed, so enabling or disabling them only matters on the Ruby side.
+ */
+#define RB_CACHED_CALLBACK_DEF(NAME, CALLBACK, GLFW_FUNC)                     \
+static VALUE NAME (VALUE self, VALUE enabled)                                 \
+{                                                                             \
+  GLFW_FUNC ( rb_get_window(self), CALLBACK );                                \
+  return self;                                                                \
+}
+
+
+/*
+ * The binding's integer timer. GLFW 3.2 and later (and the stub backend)
+ * expose their raw timer counter, which is used directly; with older versions
+ * the binding reads the platform's monotonic clock itself. Either way,
+ * s_timer_offset is the raw counter value at which Glfw.time was zero, so
+ * Glfw.time_ns and Glfw.time agree, including after Glfw.time= is used.
+ */
+static uint64_t s_timer_offset = 0;
+
+static uint64_t rb_glfw_timer_value(void)
+{
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 2) || defined(GLFW_STUB)
+  return glfwGetTimerValue();
+#elif defined(_WIN32)
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return (uint64_t)counter.QuadPart;
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+#endif
+}
+
+static uint64_t rb_glfw_timer_frequency(void)
+{
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 2) || defined(GLFW_STUB)
+  return glfwGetTimerFrequency();
+#elif defined(_WIN32)
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  return (uint64_t)frequency.QuadPart;
+#else
+  return 1000000000ULL;
+#endif
+}
+
+/* Converts a raw timer interval to nanoseconds without overflowing. */
+static int64_t rb_glfw_timer_to_ns(uint64_t ticks)
+{
+  uint64_t frequency = rb_glfw_timer_frequency();
+  return (int64_t)((ticks / frequency) * 1000000000ULL +
+                   ((ticks % frequency) * 1000000000ULL) / frequency);
+}
+
+/* Nanoseconds on the Glfw.time clock. */
+static int64_t rb_glfw_time_ns(void)
+{
+  uint64_t now = rb_glfw_timer_value();
+  if (now < s_timer_offset) {
+    return -rb_glfw_timer_to_ns(s_timer_offset - now);
+  }
+  return rb_glfw_timer_to_ns(now - s_timer_offset);
+}
+
+/* Moves the integer clock so that it currently reads time_ns. */
+static void rb_glfw_reset_timer_ns(int64_t time_ns)
+{
+  uint64_t frequency = rb_glfw_timer_frequency();
+  uint64_t magnitude = (uint64_t)(time_ns < 0 ? -time_ns : time_ns);
+  uint64_t ticks = (magnitude / 1000000000ULL) * frequency +
+                   ((magnitude % 1000000000ULL) * frequency) / 1000000000ULL;
+  uint64_t now = rb_glfw_timer_value();
+  s_timer_offset = time_ns < 0 ? now + ticks : now - ticks;
+}
+
+
+
+/* Event types counted by Glfw.callback_stats */
+enum {
+  kCALLBACK_ERROR = 0,
+  kCALLBACK_MONITOR,
+  kCALLBACK_KEY,
+  kCALLBACK_CHAR,
+  kCALLBACK_MOUSE_BUTTON,
+  kCALLBACK_CURSOR_POSITION,
+  kCALLBACK_CURSOR_ENTER,
+  kCALLBACK_SCROLL,
+  kCALLBACK_POSITION,
+  kCALLBACK_SIZE,
+  kCALLBACK_CLOSE,
+  kCALLBACK_REFRESH,
+  kCALLBACK_FOCUS,
+  kCALLBACK_ICONIFY,
+  kCALLBACK_FRAMEBUFFER_SIZE,
+  kCALLBACK_COUNT
+};
+
+static const char *kCALLBACK_NAMES[kCALLBACK_COUNT] = {
+  "error", "monitor", "key", "char", "mouse_button", "cursor_position",
+  "cursor_enter", "scroll", "position", "size", "close", "refresh", "focus",
+  "iconify", "framebuffer_size"
+};
+
+/* Span types recorded by Glfw.start_trace */
+enum {
+  kTRACE_POLL_EVENTS,
+  kTRACE_WAIT_EVENTS,
+  kTRACE_CALLBACK,
+  kTRACE_SWAP_BUFFERS,
+  kTRACE_MAKE_CONTEXT_CURRENT,
+  kTRACE_CREATE_WINDOW,
+  kTRACE_DESTROY_WINDOW,
+  kTRACE_COUNT
+};
+
+static const char *kTRACE_NAMES[kTRACE_COUNT] = {
+  "poll_events", "wait_events", "callback", "swap_buffers",
+  "make_context_current", "create_window", "destroy_window"
+};
+
+typedef struct rb_glfw_trace_span {
+  int64_t begin;
+  int64_t end;
+  const void *window;
+  int kind;
+  /* Callback event type for kTRACE_CALLBACK spans */
+  int event;
+} rb_glfw_trace_span_t;
+
+static const long kTRACE_DEFAULT_CAPACITY = 65536;
+
+/*
+ * Trace spans live in a fixed ring allocated by Glfw.start_trace, so recording
+ * never allocates. Once full, the oldest spans are overwritten.
+ */
+static int s_trace_enabled = 0;
+static rb_glfw_trace_span_t *s_trace_spans = NULL;
+static long s_trace_capacity = 0;
+static long s_trace_head = 0;
+static long s_trace_count = 0;
+
+static void rb_trace_record(int kind, int event, const void *window, int64_t begin, int64_t end)
+{
+  rb_glfw_trace_span_t *span = &s_trace_spans[s_trace_head];
+  span->begin = begin;
+  span->end = end;
+  span->window = window;
+  span->kind = kind;
+  span->event = event;
+  s_trace_head = (s_trace_head + 1) % s_trace_capacity;
+  if (s_trace_count < s_trace_capacity) {
+    ++s_trace_count;
+  }
+}
+
+/*
+ * Event recording. While Glfw.start_recording is active, every window event
+ * that reaches a trampoline is appended to a binary log as a fixed-size
+ * record. Glfw.replay_events reads the log back and calls the same
+ * trampolines, so replayed events go through the same cached-state updates,
+ * instrumentation, and Ruby callbacks as live ones.
+ *
+ * The log starts with a header of an 8 byte magic, a version, and the record
+ * size, followed by records in native byte order.
+ */
+static const char kEVENT_LOG_MAGIC[8] = { 'R', 'B', 'G', 'L', 'F', 'W', 'E', 'V' };
+static const uint32_t kEVENT_LOG_VERSION = 1;
+
+typedef struct rb_glfw_event_log_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+} rb_glfw_event_log_header_t;
+
+typedef struct rb_glfw_event_record {
+  /* Nanoseconds since recording started */
+  int64_t time;
+  /* Window's recording id, see rb_glfw_window_t.record_id */
+  uint32_t window;
+  /* kCALLBACK_* */
+  uint16_t event;
+  uint16_t reserved;
+  union {
+    int32_t i[4];
+    double d[2];
+  } args;
+} rb_glfw_event_record_t;
+
+static FILE *s_event_log = NULL;
+static int64_t s_event_log_start = 0;
+static uint32_t s_event_log_windows = 0;
+/* errno of the first failed write to the log, or 0. Reported by stop_recording. */
+static int s_event_log_error = 0;
+/* Depth of Glfw.replay_events calls, which can't overlap recording */
+static int s_replaying = 0;
+
+static void rb_record_event(rb_glfw_window_t *state, int event, rb_glfw_event_record_t *record)
+{
+  record->time = rb_glfw_time_ns() - s_event_log_start;
+  record->window = state->record_id;
+  record->event = (uint16_t)event;
+  record->reserved = 0;
+  /* Once a write fails, stop writing so the log ends on a whole record */
+  if (s_event_log_error == 0 && fwrite(record, sizeof(*record), 1, s_event_log) != 1) {
+    s_event_log_error = errno ? errno : EIO;
+  }
+}
+
+static void rb_record_ints(rb_glfw_window_t *state, int event, int a, int b, int c, int d)
+{
+  rb_glfw_event_record_t record;
+  MEMZERO(&record, rb_glfw_event_record_t, 1);
+  record.args.i[0] = a;
+  record.args.i[1] = b;
+  record.args.i[2] = c;
+  record.args.i[3] = d;
+  rb_record_event(state, event, &record);
+}
+
+static void rb_record_doubles(rb_glfw_window_t *state, int event, double x, double y)
+{
+  rb_glfw_event_record_t record;
+  MEMZERO(&record, rb_glfw_event_record_t, 1);
+  record.args.d[0] = x;
+  record.args.d[1] = y;
+  rb_record_event(state, event, &record);
+}
+
+typedef struct rb_glfw_callback_stats {
+  uint64_t counts[kCALLBACK_COUNT];
+  uint64_t time[kCALLBACK_COUNT];
+  uint64_t max_time[kCALLBACK_COUNT];
+} rb_glfw_callback_stats_t;
+
+static int s_callback_stats_enabled = 0;
+
+/* Set when callback profiling or tracing needs dispatches to be timed */
+static int s_dispatch_instrumented = 0;
+
+static void rb_update_dispatch_instrumented(void)
+{
+  s_dispatch_instrumented = s_callback_stats_enabled || s_trace_enabled;
+}
+
+/* Stats for the error and monitor callbacks, which don't belong to a window */
+static rb_glfw_callback_stats_t s_global_callback_stats;
+
+static rb_glfw_callback_stats_t *rb_callback_stats_for(rb_glfw_window_t *state)
+{
+  if (state == NULL) {
+    return &s_global_callback_stats;
+  }
+  if (state->callback_stats == NULL) {
+    state->callback_stats = ALLOC(rb_glfw_callback_stats_t);
+    MEMZERO(state->callback_stats, rb_glfw_callback_stats_t, 1);
+  }
+  return state->callback_stats;
+}
+
+static int64_t rb_callback_dispatch_begin(rb_glfw_window_t *state, int event)
+{
+  if (s_callback_stats_enabled) {
+    rb_callback_stats_for(state)->counts[event] += 1;
+  }
+  return rb_glfw_time_ns();
+}
+
+static void rb_callback_dispatch_end(rb_glfw_window_t *state, GLFWwindow *handle, int event, int64_t begin)
+{
+  int64_t end = rb_glfw_time_ns();
+
+  if (s_callback_stats_enabled) {
+    rb_glfw_callback_stats_t *stats = rb_callback_stats_for(state);
+    uint64_t elapsed = (uint64_t)(end - begin);
+    stats->time[event] += elapsed;
+    if (elapsed > stats->max_time[event]) {
+      stats->max_time[event] = elapsed;
+    }
+  }
+
+  if (s_trace_enabled) {
+    rb_trace_record(kTRACE_CALLBACK, event, handle, begin, end);
+  }
+}
+
+/*
+ * Returns the object owning a window's native state, so a dispatch can keep
+ * the state alive if the callback destroys the window.
+ */
+static VALUE rb_callback_dispatch_owner(rb_glfw_window_t *state)
+{
+  return state ? rb_ivar_get(state->rb_window, kRB_IVAR_WINDOW_INTERNAL) : Qnil;
+}
+
+static GLFWwindow *rb_callback_dispatch_handle(rb_glfw_window_t *state)
+{
+  return state ? state->handle : NULL;
+}
+
+/*
+ * Dispatches a callback into Ruby. All trampolines go through this so that
+ * instrumentation only needs to be added in one place; when it's disabled, the
+ * cost is a single branch. STATE is the window's native state, or NULL for
+ * callbacks not tied to a window. The callback may destroy the window, so its
+ * handle is read beforehand and its state's owner is guarded until the
+ * dispatch has been recorded.
+ */
+#define RB_DISPATCH_CALLBACK(STATE, EVENT, CALL)                              \
+  do {                                                                        \
+    if (s_dispatch_instrumented) {                                            \
+      VALUE dispatch_owner__ = rb_callback_dispatch_owner(STATE);             \
+      GLFWwindow *dispatch_handle__ = rb_callback_dispatch_handle(STATE);     \
+      int64_t dispatch_begin__ = rb_callback_dispatch_begin((STATE), (EVENT));\
+      CALL;                                                                   \
+      rb_callback_dispatch_end((STATE), dispatch_handle__, (EVENT),           \
+                               dispatch_begin__);                             \
+      RB_GC_GUARD(dispatch_owner__);                                          \
+    } else {                                                                  \
+      CALL;                                                                   \
+    }                                                                         \
+  } while (0)
+
+
+
 /*
  * Initializes GLFW. Returns true on success, false on failure.
  *
@@ -88,6 +902,8 @@ static VALUE rb_glfw_init(VALUE self)
   VALUE result = glfwInit() ? Qtrue : Qfalse;
   if (result == Qtrue) {
     glfwSetMonitorCallback(rb_glfw_monitor_callback);
+    rb_glfw_reset_timer_ns(0);
+    rb_glfw_reset_hints();
   }
   return result;
 }
@@ -103,6 +919,7 @@ static VALUE rb_glfw_init(VALUE self)
 static VALUE rb_glfw_terminate(VALUE self)
 {
   glfwTerminate();
+  rb_window_pool_forget();
   return self;
 }
 
@@ -127,7 +944,29 @@ static VALUE rb_glfw_version(VALUE self)
 
 
 
-static void rb_glfw_error_callback(int error_code, const char *description)
+#ifdef _MSC_VER
+#define RB_GLFW_THREAD_LOCAL __declspec(thread)
+#else
+#define RB_GLFW_THREAD_LOCAL __thread
+#endif
+
+/*
+ * GLFW reports errors synchronously on the thread that caused them, which may
+ * be in a call made with the GVL released (e.g., glfwSwapBuffers), where the
+ * error callback can't touch Ruby. Such calls go through
+ * rb_glfw_call_without_gvl, during which the error callback only records the
+ * first error, and it's reported once the GVL is held again.
+ */
+typedef struct rb_glfw_deferred_error {
+  int deferring;
+  int code;
+  char description[256];
+} rb_glfw_deferred_error_t;
+
+static RB_GLFW_THREAD_LOCAL rb_glfw_deferred_error_t s_deferred_error;
+
+/* Dispatches a GLFW error to Glfw.error_callback, or raises it if unset. */
+static void rb_glfw_report_error(int error_code, const char *description)
 {
   VALUE lambda = rb_cvar_get(s_glfw_module, kRB_CVAR_GLFW_ERROR_CALLBACK);
 
@@ -136,12 +975,68 @@ static void rb_glfw_error_callback(int error_code, const char *description)
     VALUE rb_error_code = INT2FIX(error_code);
     OBJ_FREEZE(rb_description);
     OBJ_FREEZE(rb_error_code);
-    rb_funcall(lambda, kRB_CALL, 2, rb_error_code, rb_description);
+    RB_DISPATCH_CALLBACK(NULL, kCALLBACK_ERROR,
+      rb_funcall(lambda, kRB_CALL, 2, rb_error_code, rb_description));
   } else {
     rb_raise(rb_eRuntimeError, "GLFW Error 0x%X: %s", error_code, description);
   }
 }
 
+static void rb_glfw_error_callback(int error_code, const char *description)
+{
+  rb_glfw_deferred_error_t *deferred = &s_deferred_error;
+
+  if (deferred->deferring) {
+    if (deferred->code == 0) {
+      deferred->code = error_code;
+      strncpy(deferred->description, description, sizeof(deferred->description) - 1);
+      deferred->description[sizeof(deferred->description) - 1] = '\0';
+    }
+    return;
+  }
+  rb_glfw_report_error(error_code, description);
+}
+
+typedef struct rb_glfw_nogvl_call {
+  void *(*func)(void *);
+  void *data;
+} rb_glfw_nogvl_call_t;
+
+static void *rb_glfw_deferring_errors(void *data)
+{
+  rb_glfw_nogvl_call_t *call = (rb_glfw_nogvl_call_t *)data;
+  void *result = NULL;
+
+  s_deferred_error.deferring = 1;
+  result = call->func(call->data);
+  s_deferred_error.deferring = 0;
+  return result;
+}
+
+/*
+ * Calls rb_thread_call_without_gvl for a function that calls into GLFW, then
+ * reports any GLFW error it caused.
+ */
+static void *rb_glfw_call_without_gvl(void *(*func)(void *), void *data,
+                                      rb_unblock_function_t *ubf, void *ubf_data)
+{
+  rb_glfw_nogvl_call_t call;
+  void *result = NULL;
+  int error_code = 0;
+
+  call.func = func;
+  call.data = data;
+  s_deferred_error.code = 0;
+  result = rb_thread_call_without_gvl(rb_glfw_deferring_errors, &call, ubf, ubf_data);
+
+  error_code = s_deferred_error.code;
+  if (error_code != 0) {
+    s_deferred_error.code = 0;
+    rb_glfw_report_error(error_code, s_deferred_error.description);
+  }
+  return result;
+}
+
 
 
 /*
@@ -213,6 +1108,27 @@ static VALUE rb_monitor_position(VALUE self)
 
 
 
+/*
+ * Same as #position, but stores the monitor's position in the first two
+ * elements of the given array instead of allocating a new one.
+ *
+ * call-seq:
+ *    position_into(ary) -> ary
+ *
+ * Wraps glfwGetMonitorPos.
+ */
+static VALUE rb_monitor_position_into(VALUE self, VALUE rb_out)
+{
+  GLFWmonitor *monitor = NULL;
+  int xpos = 0;
+  int ypos = 0;
+  Data_Get_Struct(self, GLFWmonitor, monitor);
+  glfwGetMonitorPos(monitor, &xpos, &ypos);
+  return rb_store_pair(rb_out, INT2FIX(xpos), INT2FIX(ypos));
+}
+
+
+
 /*
  * Gets the physical size of the monitor.
  *
@@ -233,6 +1149,27 @@ static VALUE rb_monitor_physical_size(VALUE self)
 
 
 
+/*
+ * Same as #physical_size, but stores the monitor's physical size in the first
+ * two elements of the given array instead of allocating a new one.
+ *
+ * call-seq:
+ *    physical_size_into(ary) -> ary
+ *
+ * Wraps glfwGetMonitorPhysicalSize.
+ */
+static VALUE rb_monitor_physical_size_into(VALUE self, VALUE rb_out)
+{
+  GLFWmonitor *monitor = NULL;
+  int width = 0;
+  int height = 0;
+  Data_Get_Struct(self, GLFWmonitor, monitor);
+  glfwGetMonitorPhysicalSize(monitor, &width, &height);
+  return rb_store_pair(rb_out, INT2FIX(width), INT2FIX(height));
+}
+
+
+
 /*
  * Gets the name of the monitor.
  *
@@ -258,7 +1195,8 @@ static void rb_glfw_monitor_callback(GLFWmonitor *monitor, int message)
   if (rb_obj_respond_to(lambda, kRB_CALL, 0)) {
     VALUE rb_monitor = Data_Wrap_Struct(s_glfw_monitor_klass, 0, 0, monitor);
     rb_obj_call_init(rb_monitor, 0, 0);
-    rb_funcall(lambda, kRB_CALL, 2, rb_monitor, INT2FIX(message));
+    RB_DISPATCH_CALLBACK(NULL, kCALLBACK_MONITOR,
+      rb_funcall(lambda, kRB_CALL, 2, rb_monitor, INT2FIX(message)));
   }
 }
 
@@ -564,6 +1502,7 @@ static VALUE rb_monitor_set_gamma_ramp(VALUE self, VALUE ramp_hash)
 static VALUE rb_window_default_window_hints(VALUE self)
 {
   glfwDefaultWindowHints();
+  rb_glfw_reset_hints();
   return self;
 }
 
@@ -579,92 +1518,433 @@ static VALUE rb_window_default_window_hints(VALUE self)
  */
 static VALUE rb_window_window_hint(VALUE self, VALUE target, VALUE hint)
 {
+  int index = rb_glfw_hint_index(NUM2INT(target));
   glfwWindowHint(NUM2INT(target), NUM2INT(hint));
+  if (index != -1) {
+    s_window_hints.values[index] = NUM2INT(hint);
+  } else {
+    rb_glfw_track_extra_hint(NUM2INT(target), NUM2INT(hint));
+    s_window_hints.untracked = 1;
+  }
+  s_window_hints.preset_id = 0;
   return self;
 }
 
 
-/* Auxiliary function for extracting a Glfw::Window object from a GLFWwindow. */
-static VALUE rb_lookup_window(GLFWwindow *window)
+
+static VALUE rb_hint_preset_alloc(VALUE klass)
 {
-  if (window) {
-    void *uptr = glfwGetWindowUserPointer(window);
-    if (uptr) {
-      return (VALUE)uptr;
-    }
-  }
-  return Qnil;
+  rb_glfw_hints_t *hints = NULL;
+  return Data_Make_Struct(klass, rb_glfw_hints_t, 0, -1, hints);
 }
 
-/* And the opposite of rb_lookup_window */
-static GLFWwindow *rb_get_window(VALUE rb_window)
+static rb_glfw_hints_t *rb_get_hint_preset(VALUE self)
 {
-  GLFWwindow *window = NULL;
-  if (RTEST(rb_window)) {
-    ID ivar_window = kRB_IVAR_WINDOW_INTERNAL;
-    VALUE rb_window_data = Qnil;
-    if (RTEST((rb_window_data = rb_ivar_get(rb_window, ivar_window)))) {
-      Data_Get_Struct(rb_window_data, GLFWwindow, window);
-    }
+  rb_glfw_hints_t *hints = NULL;
+  Data_Get_Struct(self, rb_glfw_hints_t, hints);
+  return hints;
+}
+
+/* Returns the kHINT_* index of a Ruby hint target, raising if it's unknown. */
+static int rb_hint_preset_index(VALUE rb_target)
+{
+  int index = rb_glfw_hint_index(NUM2INT(rb_target));
+  if (index == -1) {
+    rb_raise(rb_eArgError, "unknown window hint %d", NUM2INT(rb_target));
   }
-  return window;
+  return index;
+}
+
+static int rb_hint_preset_set_i(VALUE rb_target, VALUE rb_value, VALUE arg)
+{
+  rb_glfw_hints_t *hints = (rb_glfw_hints_t *)arg;
+  int index = rb_hint_preset_index(rb_target);
+  if (rb_value == Qtrue) {
+    hints->values[index] = GL_TRUE;
+  } else if (!RTEST(rb_value)) {
+    hints->values[index] = GL_FALSE;
+  } else {
+    hints->values[index] = NUM2INT(rb_value);
+  }
+  return ST_CONTINUE;
+}
+
+
+
+/*
+ * Compiles a Hash of window hints, mapping hint targets (e.g., Glfw::SAMPLES)
+ * to values, into a preset. Hints not in the Hash take their default values.
+ * true and false may be used for GL_TRUE and GL_FALSE. Raises ArgumentError
+ * for targets that aren't window hints.
+ *
+ * A preset is applied with #apply or passed to Glfw::Window.new, which is
+ * cheaper than a window_hint call per hint. Pooled windows created from a
+ * preset are matched to requests for the same preset without comparing hints
+ * (see Glfw::Window.pool_limit=).
+ *
+ * call-seq:
+ *    new(hints = {}) -> Glfw::Window::HintPreset
+ *
+ * For example:
+ *
+ *    MSAA = Glfw::Window::HintPreset.new(Glfw::SAMPLES => 4, Glfw::RESIZABLE => false)
+ *    window = Glfw::Window.new(640, 480, 'msaa', nil, nil, MSAA)
+ */
+static VALUE rb_hint_preset_initialize(int argc, VALUE *argv, VALUE self)
+{
+  rb_glfw_hints_t *hints = rb_get_hint_preset(self);
+  VALUE rb_hints;
+
+  rb_scan_args(argc, argv, "01", &rb_hints);
+
+  MEMCPY(hints->values, kHINT_DEFAULTS, int, kHINT_COUNT);
+  hints->preset_id = 0;
+  hints->untracked = 0;
+  if (!NIL_P(rb_hints)) {
+    rb_hash_foreach(rb_convert_type(rb_hints, T_HASH, "Hash", "to_hash"),
+                    rb_hint_preset_set_i, (VALUE)hints);
+  }
+  hints->preset_id = ++s_hint_preset_serial;
+
+  return self;
+}
+
+
+
+/*
+ * Sets the window hints to the preset's, as default_window_hints followed by a
+ * window_hint call per hint would. Like default_window_hints, this resets
+ * every hint, including ones a preset can't hold.
+ *
+ * call-seq:
+ *    apply -> self
+ */
+static VALUE rb_hint_preset_apply(VALUE self)
+{
+  rb_glfw_apply_hints(rb_get_hint_preset(self));
+  s_extra_hint_count = 0;
+  return self;
+}
+
+
+
+/*
+ * Returns the preset's value for a window hint.
+ *
+ * call-seq:
+ *    [](target) -> Integer
+ */
+static VALUE rb_hint_preset_get(VALUE self, VALUE rb_target)
+{
+  return INT2NUM(rb_get_hint_preset(self)->values[rb_hint_preset_index(rb_target)]);
+}
+
+
+
+/*
+ * Returns a Hash of every window hint target to the preset's value for it.
+ *
+ * call-seq:
+ *    to_h -> Hash
+ */
+static VALUE rb_hint_preset_to_h(VALUE self)
+{
+  const rb_glfw_hints_t *hints = rb_get_hint_preset(self);
+  VALUE rb_hints = rb_hash_new();
+  int index = 0;
+  for (; index < kHINT_COUNT; ++index) {
+    rb_hash_aset(rb_hints, INT2FIX(kHINT_TARGETS[index]), INT2NUM(hints->values[index]));
+  }
+  return rb_hints;
+}
+
+
+/* Auxiliary function for extracting a window's native state from a GLFWwindow. */
+static rb_glfw_window_t *rb_lookup_window_state(GLFWwindow *window)
+{
+  if (window) {
+    return (rb_glfw_window_t *)glfwGetWindowUserPointer(window);
+  }
+  return NULL;
+}
+
+/* Auxiliary function for extracting a Glfw::Window object from a GLFWwindow. */
+static VALUE rb_lookup_window(GLFWwindow *window)
+{
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  if (state) {
+    return state->rb_window;
+  }
+  return Qnil;
+}
+
+/* Gets the native state for a Glfw::Window, or NULL if it's been destroyed. */
+static rb_glfw_window_t *rb_get_window_state(VALUE rb_window)
+{
+  rb_glfw_window_t *state = NULL;
+  if (RTEST(rb_window)) {
+    ID ivar_window = kRB_IVAR_WINDOW_INTERNAL;
+    VALUE rb_window_data = Qnil;
+    if (RTEST((rb_window_data = rb_ivar_get(rb_window, ivar_window)))) {
+      Data_Get_Struct(rb_window_data, rb_glfw_window_t, state);
+    }
+  }
+  return state;
+}
+
+/* Same as rb_get_window_state, but raises if the window has been destroyed. */
+static rb_glfw_window_t *rb_require_window_state(VALUE rb_window)
+{
+  rb_glfw_window_t *state = rb_get_window_state(rb_window);
+  if (state == NULL || state->handle == NULL) {
+    rb_raise(rb_eRuntimeError, "Window has been destroyed");
+  }
+  return state;
+}
+
+/* And the opposite of rb_lookup_window */
+static GLFWwindow *rb_get_window(VALUE rb_window)
+{
+  rb_glfw_window_t *state = rb_get_window_state(rb_window);
+  return state ? state->handle : NULL;
+}
+
+/* Re-reads all cached window state from the window system. */
+static void rb_window_state_refresh(rb_glfw_window_t *state)
+{
+  GLFWwindow *window = state->handle;
+  glfwGetWindowPos(window, &state->x, &state->y);
+  glfwGetWindowSize(window, &state->width, &state->height);
+  glfwGetFramebufferSize(window, &state->fb_width, &state->fb_height);
+  state->focused = glfwGetWindowAttrib(window, GLFW_FOCUSED);
+  state->iconified = glfwGetWindowAttrib(window, GLFW_ICONIFIED);
+  state->visible = glfwGetWindowAttrib(window, GLFW_VISIBLE);
+  state->applied_x = state->x;
+  state->applied_y = state->y;
+  state->applied_width = state->width;
+  state->applied_height = state->height;
+}
+
+static void rb_window_state_free(void *ptr)
+{
+  rb_glfw_window_t *state = (rb_glfw_window_t *)ptr;
+  xfree(state->title);
+  xfree(state->pending_title);
+  xfree(state->frame_stats);
+  xfree(state->callback_stats);
+  xfree(state->input_latency);
+  xfree(state);
+}
+
+/* Queues the window for the next rb_glfw_flush_pending_writes. */
+static void rb_window_queue_writes(rb_glfw_window_t *state)
+{
+  if (!(state->pending_writes & kPENDING_QUEUED)) {
+    state->pending_writes |= kPENDING_QUEUED;
+    state->next_pending = s_pending_windows;
+    s_pending_windows = state;
+  }
+}
+
+/* Removes the window from the pending queue without applying its writes. */
+static void rb_window_unqueue_writes(rb_glfw_window_t *state)
+{
+  rb_glfw_window_t **link = &s_pending_windows;
+  if (state->pending_writes & kPENDING_QUEUED) {
+    while (*link) {
+      if (*link == state) {
+        *link = state->next_pending;
+        break;
+      }
+      link = &(*link)->next_pending;
+    }
+  }
+  state->next_pending = NULL;
+  state->pending_writes = 0;
+}
+
+/* Pushes a window's pending title, position, and size to the window system. */
+static void rb_window_apply_writes(rb_glfw_window_t *state)
+{
+  int pending = state->pending_writes;
+
+  rb_window_unqueue_writes(state);
+
+  if (state->handle == NULL) {
+    return;
+  }
+
+  if (pending & kPENDING_TITLE) {
+    glfwSetWindowTitle(state->handle, state->pending_title);
+    xfree(state->title);
+    state->title = state->pending_title;
+    state->pending_title = NULL;
+  }
+
+  if (pending & kPENDING_POSITION) {
+    glfwSetWindowPos(state->handle, state->pending_x, state->pending_y);
+    state->applied_x = state->pending_x;
+    state->applied_y = state->pending_y;
+  }
+
+  if (pending & kPENDING_SIZE) {
+    glfwSetWindowSize(state->handle, state->pending_width, state->pending_height);
+    state->applied_width = state->pending_width;
+    state->applied_height = state->pending_height;
+  }
+}
+
+/* Applies deferred writes for all windows. Called before polling for events. */
+static void rb_glfw_flush_pending_writes(void)
+{
+  while (s_pending_windows) {
+    rb_window_apply_writes(s_pending_windows);
+  }
+}
+
+/* Arguments to and result of rb_window_create_handle */
+typedef struct rb_window_create_args {
+  int width;
+  int height;
+  const char *title;
+  GLFWmonitor *monitor;
+  GLFWwindow *share;
+  GLFWwindow *window;
+} rb_window_create_args_t;
+
+/*
+ * Takes a window from the pool or creates one with the current hints. Called
+ * through rb_ensure when the hints have to be restored afterward, since GLFW
+ * errors raise by default.
+ */
+static VALUE rb_window_create_handle(VALUE arg)
+{
+  rb_window_create_args_t *args = (rb_window_create_args_t *)arg;
+  GLFWwindow *window = NULL;
+  int64_t create_begin = 0;
+
+  if (s_trace_enabled) {
+    create_begin = rb_glfw_time_ns();
+  }
+  if (args->monitor == NULL && s_window_pool) {
+    window = rb_window_pool_take(args->share, &s_window_hints);
+  }
+  if (window) {
+    glfwSetWindowTitle(window, args->title);
+    glfwSetWindowSize(window, args->width, args->height);
+    if (s_window_hints.values[kHINT_VISIBLE]) {
+      glfwShowWindow(window);
+    }
+  } else {
+    window = glfwCreateWindow(args->width, args->height, args->title, args->monitor, args->share);
+  }
+  if (s_trace_enabled) {
+    rb_trace_record(kTRACE_CREATE_WINDOW, 0, window, create_begin, rb_glfw_time_ns());
+  }
+  args->window = window;
+  return Qnil;
+}
+
+/* Sets the hints back to the given ones and any extra hints after a preset. */
+static VALUE rb_window_restore_hints(VALUE arg)
+{
+  int index = 0;
+  rb_glfw_apply_hints((const rb_glfw_hints_t *)arg);
+  for (; index < s_extra_hint_count; ++index) {
+    glfwWindowHint(s_extra_hints[index].target, s_extra_hints[index].value);
+  }
+  return Qnil;
 }
 
 /*
  * Creates a new window with the given parameters. If a shared window is
- * provided, the new window will use the context of the shared window.
+ * provided, the new window will use the context of the shared window. If a
+ * Glfw::Window::HintPreset is provided, the window is created with its hints
+ * rather than the current ones, which are left as they were.
  *
  * If GLFW fails to create the window or an error occurred, this function will
  * return nil.
  *
+ * If the window pool holds a window created with the same hints and shared
+ * window, and no monitor is given, that window is reused instead of creating
+ * one. See ::pool_limit=.
+ *
  * call-seq:
- *    new(width, height, title='', monitor=nil, shared_window=nil) -> Glfw::Window or nil
+ *    new(width, height, title='', monitor=nil, shared_window=nil, hints=nil) -> Glfw::Window or nil
  *
  * Wraps glfwCreateWindow.
  */
 static VALUE rb_window_new(int argc, VALUE *argv, VALUE self)
 {
   ID ivar_window = kRB_IVAR_WINDOW_INTERNAL;
-  VALUE rb_width, rb_height, rb_title, rb_monitor, rb_share;
+  VALUE rb_width, rb_height, rb_title, rb_monitor, rb_share, rb_hints;
   VALUE rb_window;
   VALUE rb_window_data;
   VALUE rb_windows;
   GLFWwindow *window = NULL;
-  int width, height;
-  const char *title = "";
-  GLFWmonitor *monitor = NULL;
-  GLFWwindow *share = NULL;
+  rb_glfw_window_t *state = NULL;
+  rb_window_create_args_t args;
+  rb_glfw_hints_t hints;
+  rb_glfw_hints_t previous_hints;
 
   /* Grab arguments */
-  rb_scan_args(argc, argv, "23", &rb_width, &rb_height, &rb_title, &rb_monitor, &rb_share);
+  rb_scan_args(argc, argv, "24", &rb_width, &rb_height, &rb_title, &rb_monitor, &rb_share, &rb_hints);
 
-  width = NUM2INT(rb_width);
-  height = NUM2INT(rb_height);
+  args.width = NUM2INT(rb_width);
+  args.height = NUM2INT(rb_height);
+  args.title = "";
+  args.monitor = NULL;
+  args.share = NULL;
+  args.window = NULL;
 
   if (RTEST(rb_title)) {
     if (rb_type(rb_title) != T_STRING) {
       rb_title = rb_any_to_s(rb_title);
     }
-    title = StringValueCStr(rb_title);
+    args.title = StringValueCStr(rb_title);
   }
 
   if (Q_IS_A(rb_monitor, s_glfw_monitor_klass)) {
-    Data_Get_Struct(rb_monitor, GLFWmonitor, monitor);
+    Data_Get_Struct(rb_monitor, GLFWmonitor, args.monitor);
   }
 
   if (Q_IS_A(rb_share, s_glfw_window_klass)) {
-    VALUE rb_shared_window = rb_ivar_get(rb_share, ivar_window);
-    Data_Get_Struct(rb_shared_window, GLFWwindow, share);
+    args.share = rb_get_window(rb_share);
+  }
+
+  if (!NIL_P(rb_hints) && !Q_IS_A(rb_hints, s_glfw_hint_preset_klass)) {
+    rb_raise(rb_eArgError, "hints must be a Glfw::Window::HintPreset");
   }
 
   /* Create GLFW window */
-  window = glfwCreateWindow(width, height, title, monitor, share);
+  if (NIL_P(rb_hints)) {
+    hints = s_window_hints;
+    rb_window_create_handle((VALUE)&args);
+  } else {
+    hints = *rb_get_hint_preset(rb_hints);
+    previous_hints = s_window_hints;
+    rb_glfw_apply_hints(&hints);
+    rb_ensure(rb_window_create_handle, (VALUE)&args,
+              rb_window_restore_hints, (VALUE)&previous_hints);
+  }
+  window = args.window;
   if (window == NULL) {
     return Qnil;
   }
 
-  /* Allocate the window wrapper (only used to store the window pointer) */
-  rb_window_data = Data_Wrap_Struct(s_glfw_window_internal_klass, 0, 0, window);
+  /* Allocate the window wrapper (stores the window pointer and cached state) */
+  state = ALLOC(rb_glfw_window_t);
+  MEMZERO(state, rb_glfw_window_t, 1);
+  state->handle = window;
+  state->rb_window = Qnil;
+  state->title = ruby_strdup(args.title);
+  state->hints = hints;
+  state->monitor = args.monitor;
+  state->share = args.share;
+  if (s_event_log) {
+    state->record_id = ++s_event_log_windows;
+  }
+  rb_window_data = Data_Wrap_Struct(s_glfw_window_internal_klass, 0, rb_window_state_free, state);
   rb_obj_call_init(rb_window_data, 0, 0);
 
   /* Allocate the window */
@@ -685,7 +1965,19 @@ static VALUE rb_window_new(int argc, VALUE *argv, VALUE self)
   rb_ivar_set(rb_window, kRB_IVAR_WINDOW_ICONIFY_CALLBACK, Qnil);
   rb_ivar_set(rb_window, kRB_IVAR_WINDOW_FRAMEBUFFER_SIZE_CALLBACK, Qnil);
 
-  glfwSetWindowUserPointer(window, (void *)rb_window);
+  state->rb_window = rb_window;
+  glfwSetWindowUserPointer(window, (void *)state);
+
+  /* Keep the cached state current from here on */
+  rb_window_state_refresh(state);
+  state->dirty = 1;
+  glfwSetWindowPosCallback(window, rb_window_window_position_callback);
+  glfwSetWindowSizeCallback(window, rb_window_window_size_callback);
+  glfwSetFramebufferSizeCallback(window, rb_window_fbsize_callback);
+  glfwSetWindowRefreshCallback(window, rb_window_refresh_callback);
+  glfwSetWindowFocusCallback(window, rb_window_focus_callback);
+  glfwSetWindowIconifyCallback(window, rb_window_iconify_callback);
+
   rb_obj_call_init(rb_window, 0, 0);
 
   /* Store the window so it can't go out of scope until explicitly destroyed. */
@@ -698,16 +1990,26 @@ static VALUE rb_window_new(int argc, VALUE *argv, VALUE self)
 
 
 /*
- * Destroys the window.
+ * Destroys the window. If the window pool has room, the window is hidden and
+ * kept for reuse by ::new instead. See ::pool_limit=.
  *
  * Wraps glfwDestroyWindow.
  */
 static VALUE rb_window_destroy(VALUE self)
 {
   VALUE rb_windows = Qnil;
-  GLFWwindow *window = rb_get_window(self);
+  rb_glfw_window_t *state = rb_get_window_state(self);
+  GLFWwindow *window = state ? state->handle : NULL;
   if (window) {
-    glfwDestroyWindow(window);
+    int64_t destroy_begin = s_trace_enabled ? rb_glfw_time_ns() : 0;
+    rb_window_unqueue_writes(state);
+    if (!rb_window_pool_put(state)) {
+      rb_window_pool_destroy(window);
+    }
+    if (s_trace_enabled) {
+      rb_trace_record(kTRACE_DESTROY_WINDOW, 0, window, destroy_begin, rb_glfw_time_ns());
+    }
+    state->handle = NULL;
     rb_ivar_set(self, kRB_IVAR_WINDOW_INTERNAL, Qnil);
     rb_windows = rb_cvar_get(s_glfw_window_klass, kRB_CVAR_WINDOW_WINDOWS);
     rb_hash_delete(rb_windows, INT2FIX((int)window));
@@ -717,6 +2019,102 @@ static VALUE rb_window_destroy(VALUE self)
 
 
 
+/*
+ * Sets how many destroyed windows may be kept hidden for reuse by ::new,
+ * which is cheaper than creating a window and its context from scratch.
+ * Defaults to 0, which disables pooling. Lowering the limit destroys pooled
+ * windows over it.
+ *
+ * Only windowed (not full screen) windows are pooled. A pooled window is
+ * reused when a window is requested with the same window hints (other than
+ * Glfw::VISIBLE) and shared window. Windows created while a hint GLFW 3.0
+ * doesn't define is set are never matched, since their hints aren't fully
+ * known. Its title and size are set and it's shown
+ * if Glfw::VISIBLE is set, but it keeps its last position, and its context
+ * keeps whatever GL state was left in it.
+ *
+ * call-seq:
+ *    pool_limit = limit
+ */
+static VALUE rb_window_set_pool_limit(VALUE self, VALUE rb_limit)
+{
+  long limit = NUM2LONG(rb_limit);
+  if (limit < 0) {
+    rb_raise(rb_eArgError, "pool limit must not be negative");
+  }
+  s_window_pool_limit = limit;
+  rb_window_pool_trim(limit);
+  return rb_limit;
+}
+
+
+
+/*
+ * Returns how many destroyed windows may be kept for reuse. See
+ * ::pool_limit=.
+ *
+ * call-seq:
+ *    pool_limit -> Integer
+ */
+static VALUE rb_window_get_pool_limit(VALUE self)
+{
+  return LONG2NUM(s_window_pool_limit);
+}
+
+
+
+/*
+ * Returns how many destroyed windows are currently kept for reuse.
+ *
+ * call-seq:
+ *    pooled_count -> Integer
+ */
+static VALUE rb_window_pooled_count(VALUE self)
+{
+  return LONG2NUM(s_window_pool_count);
+}
+
+
+
+/*
+ * Destroys all pooled windows, leaving the pool limit as it is.
+ *
+ * call-seq:
+ *    drain_pool -> self
+ */
+static VALUE rb_window_drain_pool(VALUE self)
+{
+  rb_window_pool_trim(0);
+  return self;
+}
+
+
+
+/*
+ * Returns a Glfw::Window::HintPreset of the hints the window was created
+ * with, e.g., for creating more windows whose contexts are compatible with
+ * its own. Only holds hints a preset can; see Glfw::Window::HintPreset.new.
+ *
+ * call-seq:
+ *    hint_preset -> Glfw::Window::HintPreset
+ */
+static VALUE rb_window_get_hint_preset(VALUE self)
+{
+  rb_glfw_window_t *state = rb_require_window_state(self);
+  VALUE rb_preset = rb_obj_alloc(s_glfw_hint_preset_klass);
+  rb_glfw_hints_t *hints = rb_get_hint_preset(rb_preset);
+
+  *hints = state->hints;
+  hints->untracked = 0;
+  /* A window created from a preset keeps that preset's identity */
+  if (hints->preset_id == 0) {
+    hints->preset_id = ++s_hint_preset_serial;
+  }
+  return rb_preset;
+}
+
+
+
 /*
  * Gets the window's should-close flag.
  *
@@ -754,7 +2152,9 @@ static VALUE rb_window_set_should_close(VALUE self, VALUE value)
 
 
 /*
- * Sets the window's title.
+ * Sets the window's title. If the window has deferred writes enabled, the
+ * title is applied at the next flush, and only if it differs from the current
+ * title (see #deferred_writes=).
  *
  * call-seq:
  *    title=(new_title) -> new_title
@@ -764,7 +2164,24 @@ static VALUE rb_window_set_should_close(VALUE self, VALUE value)
  */
 static VALUE rb_window_set_title(VALUE self, VALUE new_title)
 {
-  glfwSetWindowTitle(rb_get_window(self), StringValueCStr(new_title));
+  rb_glfw_window_t *state = rb_require_window_state(self);
+  const char *title = StringValueCStr(new_title);
+
+  if (state->deferred_writes) {
+    xfree(state->pending_title);
+    state->pending_title = NULL;
+    state->pending_writes &= ~kPENDING_TITLE;
+    if (strcmp(title, state->title) != 0) {
+      state->pending_title = ruby_strdup(title);
+      state->pending_writes |= kPENDING_TITLE;
+      rb_window_queue_writes(state);
+    }
+  } else {
+    glfwSetWindowTitle(state->handle, title);
+    xfree(state->title);
+    state->title = ruby_strdup(title);
+  }
+
   return new_title;
 }
 
@@ -789,7 +2206,28 @@ static VALUE rb_window_get_position(VALUE self)
 
 
 /*
- * Moves the window to a new location (sets its position).
+ * Same as #position, but stores the window's position in the first two
+ * elements of the given array instead of allocating a new one.
+ *
+ * call-seq:
+ *    get_position_into(ary) -> ary
+ *
+ * Wraps glfwGetWindowPos.
+ */
+static VALUE rb_window_get_position_into(VALUE self, VALUE rb_out)
+{
+  int xpos = 0;
+  int ypos = 0;
+  glfwGetWindowPos(rb_get_window(self), &xpos, &ypos);
+  return rb_store_pair(rb_out, INT2FIX(xpos), INT2FIX(ypos));
+}
+
+
+
+/*
+ * Moves the window to a new location (sets its position). If the window has
+ * deferred writes enabled, the move is applied at the next flush, and only if
+ * it differs from the window's current position (see #deferred_writes=).
  *
  * call-seq:
  *    set_position(x, y) -> self
@@ -799,7 +2237,24 @@ static VALUE rb_window_get_position(VALUE self)
  */
 static VALUE rb_window_set_position(VALUE self, VALUE x, VALUE y)
 {
-  glfwSetWindowPos(rb_get_window(self), NUM2INT(x), NUM2INT(y));
+  rb_glfw_window_t *state = rb_require_window_state(self);
+  int xpos = NUM2INT(x);
+  int ypos = NUM2INT(y);
+
+  if (state->deferred_writes) {
+    state->pending_writes &= ~kPENDING_POSITION;
+    if (xpos != state->applied_x || ypos != state->applied_y) {
+      state->pending_x = xpos;
+      state->pending_y = ypos;
+      state->pending_writes |= kPENDING_POSITION;
+      rb_window_queue_writes(state);
+    }
+  } else {
+    glfwSetWindowPos(state->handle, xpos, ypos);
+    state->applied_x = xpos;
+    state->applied_y = ypos;
+  }
+
   return self;
 }
 
@@ -824,7 +2279,28 @@ static VALUE rb_window_get_size(VALUE self)
 
 
 /*
- * Sets the window's size.
+ * Same as #size, but stores the window's size in the first two elements of the
+ * given array instead of allocating a new one.
+ *
+ * call-seq:
+ *    get_size_into(ary) -> ary
+ *
+ * Wraps glfwGetWindowSize.
+ */
+static VALUE rb_window_get_size_into(VALUE self, VALUE rb_out)
+{
+  int width = 0;
+  int height = 0;
+  glfwGetWindowSize(rb_get_window(self), &width, &height);
+  return rb_store_pair(rb_out, INT2FIX(width), INT2FIX(height));
+}
+
+
+
+/*
+ * Sets the window's size. If the window has deferred writes enabled, the
+ * resize is applied at the next flush, and only if it differs from the
+ * window's current size (see #deferred_writes=).
  *
  * call-seq:
  *    set_size(width, height) -> self
@@ -834,49 +2310,322 @@ static VALUE rb_window_get_size(VALUE self)
  */
 static VALUE rb_window_set_size(VALUE self, VALUE width, VALUE height)
 {
-  glfwSetWindowSize(rb_get_window(self), NUM2INT(width), NUM2INT(height));
+  rb_glfw_window_t *state = rb_require_window_state(self);
+  int new_width = NUM2INT(width);
+  int new_height = NUM2INT(height);
+
+  if (state->deferred_writes) {
+    state->pending_writes &= ~kPENDING_SIZE;
+    if (new_width != state->applied_width || new_height != state->applied_height) {
+      state->pending_width = new_width;
+      state->pending_height = new_height;
+      state->pending_writes |= kPENDING_SIZE;
+      rb_window_queue_writes(state);
+    }
+  } else {
+    glfwSetWindowSize(state->handle, new_width, new_height);
+    state->applied_width = new_width;
+    state->applied_height = new_height;
+  }
+
   return self;
 }
 
 
 
 /*
- * Gets the window context's framebuffer size.
+ * Enables or disables deferred writes for the window's title, position, and
+ * size. While enabled, #title=, #set_position, and #set_size only record the
+ * new value; the last value written for each property is pushed to the window
+ * system in one batch by the next Glfw::poll_events, Glfw::wait_events, or
+ * #swap_buffers, and writes that wouldn't change anything are dropped.
  *
- * call-seq:
- *    framebuffer_size -> [width, height]
+ * Disabling deferred writes flushes any pending writes immediately.
  *
- * Wraps glfwGetFramebufferSize.
+ * call-seq:
+ *    deferred_writes = enabled -> enabled
  */
-static VALUE rb_window_get_framebuffer_size(VALUE self)
+static VALUE rb_window_set_deferred_writes(VALUE self, VALUE enabled)
 {
-  int width = 0;
-  int height = 0;
-  glfwGetFramebufferSize(rb_get_window(self), &width, &height);
-  return rb_ary_new3(2, INT2FIX(width), INT2FIX(height));
+  rb_glfw_window_t *state = rb_require_window_state(self);
+  state->deferred_writes = RTEST(enabled);
+  if (!state->deferred_writes) {
+    rb_window_apply_writes(state);
+  }
+  return enabled;
 }
 
 
 
 /*
- * Iconifies the window.
+ * Returns whether the window defers title, position, and size writes. See
+ * #deferred_writes=.
  *
- * Wraps glfwIconifyWindow.
+ * call-seq:
+ *    deferred_writes? -> true or false
  */
-static VALUE rb_window_iconify(VALUE self)
+static VALUE rb_window_get_deferred_writes(VALUE self)
 {
-  glfwIconifyWindow(rb_get_window(self));
-  return self;
+  return rb_require_window_state(self)->deferred_writes ? Qtrue : Qfalse;
 }
 
 
 
 /*
- * Restores the window.
+ * Immediately pushes any deferred title, position, and size writes for the
+ * window to the window system. See #deferred_writes=.
  *
- * Wraps glfwRestoreWindow.
+ * call-seq:
+ *    flush_writes -> self
  */
-static VALUE rb_window_restore(VALUE self)
+static VALUE rb_window_flush_writes(VALUE self)
+{
+  rb_window_apply_writes(rb_require_window_state(self));
+  return self;
+}
+
+
+
+/*
+ * Gets the window context's framebuffer size.
+ *
+ * call-seq:
+ *    framebuffer_size -> [width, height]
+ *
+ * Wraps glfwGetFramebufferSize.
+ */
+static VALUE rb_window_get_framebuffer_size(VALUE self)
+{
+  int width = 0;
+  int height = 0;
+  glfwGetFramebufferSize(rb_get_window(self), &width, &height);
+  return rb_ary_new3(2, INT2FIX(width), INT2FIX(height));
+}
+
+
+
+/*
+ * Same as #framebuffer_size, but stores the framebuffer size in the first two
+ * elements of the given array instead of allocating a new one.
+ *
+ * call-seq:
+ *    framebuffer_size_into(ary) -> ary
+ *
+ * Wraps glfwGetFramebufferSize.
+ */
+static VALUE rb_window_get_framebuffer_size_into(VALUE self, VALUE rb_out)
+{
+  int width = 0;
+  int height = 0;
+  glfwGetFramebufferSize(rb_get_window(self), &width, &height);
+  return rb_store_pair(rb_out, INT2FIX(width), INT2FIX(height));
+}
+
+
+
+/*
+ * Gets the window's X position in screen space as last reported by the window
+ * system. Unlike #position, this doesn't allocate or query the window system.
+ * See also #refresh_cache.
+ *
+ * call-seq:
+ *    x -> Fixed
+ */
+static VALUE rb_window_cached_x(VALUE self)
+{
+  return INT2FIX(rb_require_window_state(self)->x);
+}
+
+
+
+/*
+ * Gets the window's Y position in screen space as last reported by the window
+ * system. See also #x and #refresh_cache.
+ *
+ * call-seq:
+ *    y -> Fixed
+ */
+static VALUE rb_window_cached_y(VALUE self)
+{
+  return INT2FIX(rb_require_window_state(self)->y);
+}
+
+
+
+/*
+ * Gets the window's width as last reported by the window system. Unlike #size,
+ * this doesn't allocate or query the window system. See also #refresh_cache.
+ *
+ * call-seq:
+ *    width -> Fixed
+ */
+static VALUE rb_window_cached_width(VALUE self)
+{
+  return INT2FIX(rb_require_window_state(self)->width);
+}
+
+
+
+/*
+ * Gets the window's height as last reported by the window system. See also
+ * #width and #refresh_cache.
+ *
+ * call-seq:
+ *    height -> Fixed
+ */
+static VALUE rb_window_cached_height(VALUE self)
+{
+  return INT2FIX(rb_require_window_state(self)->height);
+}
+
+
+
+/*
+ * Gets the width of the window's framebuffer as last reported by the window
+ * system. See also #framebuffer_size and #refresh_cache.
+ *
+ * call-seq:
+ *    framebuffer_width -> Fixed
+ */
+static VALUE rb_window_cached_fb_width(VALUE self)
+{
+  return INT2FIX(rb_require_window_state(self)->fb_width);
+}
+
+
+
+/*
+ * Gets the height of the window's framebuffer as last reported by the window
+ * system. See also #framebuffer_size and #refresh_cache.
+ *
+ * call-seq:
+ *    framebuffer_height -> Fixed
+ */
+static VALUE rb_window_cached_fb_height(VALUE self)
+{
+  return INT2FIX(rb_require_window_state(self)->fb_height);
+}
+
+
+
+/*
+ * Returns whether the window had input focus as of the last focus event.
+ *
+ * call-seq:
+ *    focused? -> true or false
+ */
+static VALUE rb_window_cached_focused(VALUE self)
+{
+  return rb_require_window_state(self)->focused ? Qtrue : Qfalse;
+}
+
+
+
+/*
+ * Returns whether the window was iconified as of the last iconify event.
+ *
+ * call-seq:
+ *    iconified? -> true or false
+ */
+static VALUE rb_window_cached_iconified(VALUE self)
+{
+  return rb_require_window_state(self)->iconified ? Qtrue : Qfalse;
+}
+
+
+
+/*
+ * Re-reads the window's position, size, framebuffer size, focus, and iconify
+ * state from the window system. The cached values are normally kept current by
+ * window events, so this is only needed if you must see the effect of, say,
+ * #set_size before the next call to Glfw::poll_events.
+ *
+ * call-seq:
+ *    refresh_cache -> self
+ *
+ * Wraps glfwGetWindowPos, glfwGetWindowSize, glfwGetFramebufferSize, and
+ * glfwGetWindowAttrib.
+ */
+static VALUE rb_window_refresh_cache(VALUE self)
+{
+  rb_window_state_refresh(rb_require_window_state(self));
+  return self;
+}
+
+
+
+/*
+ * Gathers the window's should-close flag, position, size, framebuffer size,
+ * cursor position, input modes, focus, and iconify state into a
+ * Glfw::Window::Snapshot in a single call. If a snapshot is given, it's filled
+ * in and returned instead of allocating a new one, so a loop can reuse one
+ * snapshot per window.
+ *
+ * Geometry, focus, and iconify state come from the window's cached state (see
+ * #refresh_cache); the rest is queried from GLFW.
+ *
+ * call-seq:
+ *    snapshot(into = nil) -> Glfw::Window::Snapshot
+ *
+ * Wraps glfwWindowShouldClose, glfwGetCursorPos, and glfwGetInputMode.
+ */
+static VALUE rb_window_snapshot(int argc, VALUE *argv, VALUE self)
+{
+  rb_glfw_window_t *state = rb_require_window_state(self);
+  GLFWwindow *window = state->handle;
+  VALUE rb_into = Qnil;
+  double cursor_x = 0;
+  double cursor_y = 0;
+
+  rb_scan_args(argc, argv, "01", &rb_into);
+
+  if (NIL_P(rb_into)) {
+    rb_into = rb_class_new_instance(0, NULL, s_glfw_window_snapshot_klass);
+  } else if (!Q_IS_A(rb_into, s_glfw_window_snapshot_klass)) {
+    rb_raise(rb_eArgError, "into must be a Glfw::Window::Snapshot");
+  }
+
+  glfwGetCursorPos(window, &cursor_x, &cursor_y);
+
+  RSTRUCT_SET(rb_into, kSNAPSHOT_SHOULD_CLOSE, glfwWindowShouldClose(window) ? Qtrue : Qfalse);
+  RSTRUCT_SET(rb_into, kSNAPSHOT_X, INT2FIX(state->x));
+  RSTRUCT_SET(rb_into, kSNAPSHOT_Y, INT2FIX(state->y));
+  RSTRUCT_SET(rb_into, kSNAPSHOT_WIDTH, INT2FIX(state->width));
+  RSTRUCT_SET(rb_into, kSNAPSHOT_HEIGHT, INT2FIX(state->height));
+  RSTRUCT_SET(rb_into, kSNAPSHOT_FRAMEBUFFER_WIDTH, INT2FIX(state->fb_width));
+  RSTRUCT_SET(rb_into, kSNAPSHOT_FRAMEBUFFER_HEIGHT, INT2FIX(state->fb_height));
+  RSTRUCT_SET(rb_into, kSNAPSHOT_CURSOR_X, rb_float_new(cursor_x));
+  RSTRUCT_SET(rb_into, kSNAPSHOT_CURSOR_Y, rb_float_new(cursor_y));
+  RSTRUCT_SET(rb_into, kSNAPSHOT_CURSOR_MODE, INT2FIX(glfwGetInputMode(window, GLFW_CURSOR)));
+  RSTRUCT_SET(rb_into, kSNAPSHOT_STICKY_KEYS, glfwGetInputMode(window, GLFW_STICKY_KEYS) ? Qtrue : Qfalse);
+  RSTRUCT_SET(rb_into, kSNAPSHOT_STICKY_MOUSE_BUTTONS, glfwGetInputMode(window, GLFW_STICKY_MOUSE_BUTTONS) ? Qtrue : Qfalse);
+  RSTRUCT_SET(rb_into, kSNAPSHOT_FOCUSED, state->focused ? Qtrue : Qfalse);
+  RSTRUCT_SET(rb_into, kSNAPSHOT_ICONIFIED, state->iconified ? Qtrue : Qfalse);
+
+  return rb_into;
+}
+
+
+
+/*
+ * Iconifies the window.
+ *
+ * Wraps glfwIconifyWindow.
+ */
+static VALUE rb_window_iconify(VALUE self)
+{
+  glfwIconifyWindow(rb_get_window(self));
+  return self;
+}
+
+
+
+/*
+ * Restores the window.
+ *
+ * Wraps glfwRestoreWindow.
+ */
+static VALUE rb_window_restore(VALUE self)
 {
   glfwRestoreWindow(rb_get_window(self));
   return self;
@@ -891,7 +2640,13 @@ static VALUE rb_window_restore(VALUE self)
  */
 static VALUE rb_window_show(VALUE self)
 {
-  glfwShowWindow(rb_get_window(self));
+  rb_glfw_window_t *state = rb_get_window_state(self);
+  glfwShowWindow(state ? state->handle : NULL);
+  if (state) {
+    /* GLFW 3.0 has no callback for this, so track it here */
+    state->visible = 1;
+    state->dirty = 1;
+  }
   return self;
 }
 
@@ -904,7 +2659,12 @@ static VALUE rb_window_show(VALUE self)
  */
 static VALUE rb_window_hide(VALUE self)
 {
-  glfwHideWindow(rb_get_window(self));
+  rb_glfw_window_t *state = rb_get_window_state(self);
+  glfwHideWindow(state ? state->handle : NULL);
+  if (state) {
+    /* GLFW 3.0 has no callback for this, so track it here */
+    state->visible = 0;
+  }
   return self;
 }
 
@@ -934,41 +2694,61 @@ static VALUE rb_window_get_monitor(VALUE self)
 
 static void rb_window_window_position_callback(GLFWwindow *window, int x, int y)
 {
-  VALUE rb_window = rb_lookup_window(window);
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  VALUE rb_window = state ? state->rb_window : Qnil;
   if (RTEST(rb_window)) {
     VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_POSITION_CALLBACK);
+    if (s_event_log) {
+      rb_record_ints(state, kCALLBACK_POSITION, x, y, 0, 0);
+    }
+    state->x = state->applied_x = x;
+    state->y = state->applied_y = y;
     if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
-      rb_funcall(rb_func, kRB_CALL, 3, rb_window, INT2FIX(x), INT2FIX(y));
+      RB_DISPATCH_CALLBACK(state, kCALLBACK_POSITION,
+        rb_funcall(rb_func, kRB_CALL, 3, rb_window, INT2FIX(x), INT2FIX(y)));
     }
   }
 }
 
-RB_ENABLE_CALLBACK_DEF(rb_window_set_window_position_callback, rb_window_window_position_callback, glfwSetWindowPosCallback);
+RB_CACHED_CALLBACK_DEF(rb_window_set_window_position_callback, rb_window_window_position_callback, glfwSetWindowPosCallback);
 
 
 
 static void rb_window_window_size_callback(GLFWwindow *window, int width, int height)
 {
-  VALUE rb_window = rb_lookup_window(window);
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  VALUE rb_window = state ? state->rb_window : Qnil;
   if (RTEST(rb_window)) {
     VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_SIZE_CALLBACK);
+    if (s_event_log) {
+      rb_record_ints(state, kCALLBACK_SIZE, width, height, 0, 0);
+    }
+    state->width = state->applied_width = width;
+    state->height = state->applied_height = height;
+    state->dirty = 1;
     if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
-      rb_funcall(rb_func, kRB_CALL, 3, rb_window, INT2FIX(width), INT2FIX(height));
+      RB_DISPATCH_CALLBACK(state, kCALLBACK_SIZE,
+        rb_funcall(rb_func, kRB_CALL, 3, rb_window, INT2FIX(width), INT2FIX(height)));
     }
   }
 }
 
-RB_ENABLE_CALLBACK_DEF(rb_window_set_window_size_callback, rb_window_window_size_callback, glfwSetWindowSizeCallback);
+RB_CACHED_CALLBACK_DEF(rb_window_set_window_size_callback, rb_window_window_size_callback, glfwSetWindowSizeCallback);
 
 
 
 static void rb_window_close_callback(GLFWwindow *window)
 {
-  VALUE rb_window = rb_lookup_window(window);
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  VALUE rb_window = state ? state->rb_window : Qnil;
   if (RTEST(rb_window)) {
     VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_CLOSE_CALLBACK);
+    if (s_event_log) {
+      rb_record_ints(state, kCALLBACK_CLOSE, 0, 0, 0, 0);
+    }
     if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
-      rb_funcall(rb_func, kRB_CALL, 1, rb_window);
+      RB_DISPATCH_CALLBACK(state, kCALLBACK_CLOSE,
+        rb_funcall(rb_func, kRB_CALL, 1, rb_window));
     }
   }
 }
@@ -979,563 +2759,3497 @@ RB_ENABLE_CALLBACK_DEF(rb_window_set_close_callback, rb_window_close_callback, g
 
 static void rb_window_refresh_callback(GLFWwindow *window)
 {
-  VALUE rb_window = rb_lookup_window(window);
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  VALUE rb_window = state ? state->rb_window : Qnil;
   if (RTEST(rb_window)) {
     VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_REFRESH_CALLBACK);
+    if (s_event_log) {
+      rb_record_ints(state, kCALLBACK_REFRESH, 0, 0, 0, 0);
+    }
+    state->dirty = 1;
     if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
-      rb_funcall(rb_func, kRB_CALL, 1, rb_window);
+      RB_DISPATCH_CALLBACK(state, kCALLBACK_REFRESH,
+        rb_funcall(rb_func, kRB_CALL, 1, rb_window));
     }
   }
 }
 
-RB_ENABLE_CALLBACK_DEF(rb_window_set_refresh_callback, rb_window_refresh_callback, glfwSetWindowRefreshCallback);
+RB_CACHED_CALLBACK_DEF(rb_window_set_refresh_callback, rb_window_refresh_callback, glfwSetWindowRefreshCallback);
 
 
 
 static void rb_window_focus_callback(GLFWwindow *window, int focused)
 {
-  VALUE rb_window = rb_lookup_window(window);
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  VALUE rb_window = state ? state->rb_window : Qnil;
   if (RTEST(rb_window)) {
     VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_FOCUS_CALLBACK);
+    if (s_event_log) {
+      rb_record_ints(state, kCALLBACK_FOCUS, focused, 0, 0, 0);
+    }
+    state->focused = focused;
+    state->dirty = 1;
     if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
-      rb_funcall(rb_func, kRB_CALL, 2, rb_window, focused ? Qtrue : Qfalse);
+      RB_DISPATCH_CALLBACK(state, kCALLBACK_FOCUS,
+        rb_funcall(rb_func, kRB_CALL, 2, rb_window, focused ? Qtrue : Qfalse));
     }
   }
 }
 
-RB_ENABLE_CALLBACK_DEF(rb_window_set_focus_callback, rb_window_focus_callback, glfwSetWindowFocusCallback);
+RB_CACHED_CALLBACK_DEF(rb_window_set_focus_callback, rb_window_focus_callback, glfwSetWindowFocusCallback);
 
 
 
 static void rb_window_iconify_callback(GLFWwindow *window, int iconified)
 {
-  VALUE rb_window = rb_lookup_window(window);
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  VALUE rb_window = state ? state->rb_window : Qnil;
   if (RTEST(rb_window)) {
     VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_ICONIFY_CALLBACK);
+    if (s_event_log) {
+      rb_record_ints(state, kCALLBACK_ICONIFY, iconified, 0, 0, 0);
+    }
+    state->iconified = iconified;
+    if (!iconified) {
+      state->dirty = 1;
+    }
     if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
-      rb_funcall(rb_func, kRB_CALL, 2, rb_window, iconified ? Qtrue : Qfalse);
+      RB_DISPATCH_CALLBACK(state, kCALLBACK_ICONIFY,
+        rb_funcall(rb_func, kRB_CALL, 2, rb_window, iconified ? Qtrue : Qfalse));
     }
   }
 }
 
-RB_ENABLE_CALLBACK_DEF(rb_window_set_iconify_callback, rb_window_iconify_callback, glfwSetWindowIconifyCallback);
+RB_CACHED_CALLBACK_DEF(rb_window_set_iconify_callback, rb_window_iconify_callback, glfwSetWindowIconifyCallback);
 
 
 
 static void rb_window_fbsize_callback(GLFWwindow *window, int width, int height)
 {
-  VALUE rb_window = rb_lookup_window(window);
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  VALUE rb_window = state ? state->rb_window : Qnil;
   if (RTEST(rb_window)) {
     VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_FRAMEBUFFER_SIZE_CALLBACK);
+    if (s_event_log) {
+      rb_record_ints(state, kCALLBACK_FRAMEBUFFER_SIZE, width, height, 0, 0);
+    }
+    state->fb_width = width;
+    state->fb_height = height;
+    state->dirty = 1;
     if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
-      rb_funcall(rb_func, kRB_CALL, 3, rb_window, INT2FIX(width), INT2FIX(height));
+      RB_DISPATCH_CALLBACK(state, kCALLBACK_FRAMEBUFFER_SIZE,
+        rb_funcall(rb_func, kRB_CALL, 3, rb_window, INT2FIX(width), INT2FIX(height)));
     }
   }
 }
 
-RB_ENABLE_CALLBACK_DEF(rb_window_set_fbsize_callback, rb_window_fbsize_callback, glfwSetFramebufferSizeCallback);
+RB_CACHED_CALLBACK_DEF(rb_window_set_fbsize_callback, rb_window_fbsize_callback, glfwSetFramebufferSizeCallback);
 
 
 
 /*
- * Polls for events without blocking until an event occurs.
- *
- * Wraps glfwPollEvents.
- *
- * This would likely be called at the beginning of your main loop, like so:
- *
- *    loop {
- *      Glfw.poll_events()
- *
- *      # ...
- *    }
+ * Log-linear (HDR-style) histogram of nanosecond durations. Each power of two
+ * is split into kHIST_SUB_BUCKETS linear buckets, so values are recorded with
+ * about 6% precision from 1ns up to kHIST_MAX_VALUE, and recording one is a
+ * couple of shifts and an increment.
  */
-static VALUE rb_glfw_poll_events(VALUE self)
+#define kHIST_SUB_BITS      4
+#define kHIST_SUB_BUCKETS   (1 << kHIST_SUB_BITS)
+#define kHIST_MAX_BITS      36
+#define kHIST_MAX_VALUE     ((((uint64_t)1) << kHIST_MAX_BITS) - 1)
+#define kHIST_NUM_BUCKETS   ((kHIST_MAX_BITS - kHIST_SUB_BITS + 1) * kHIST_SUB_BUCKETS)
+
+typedef struct rb_glfw_histogram {
+  uint32_t counts[kHIST_NUM_BUCKETS];
+  uint64_t count;
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+} rb_glfw_histogram_t;
+
+static int rb_histogram_bucket(uint64_t value)
 {
-  glfwPollEvents();
-  return self;
+  int msb = 0;
+  int shift = 0;
+  if (value < kHIST_SUB_BUCKETS) {
+    return (int)value;
+  }
+  if (value > kHIST_MAX_VALUE) {
+    value = kHIST_MAX_VALUE;
+  }
+  for (msb = kHIST_SUB_BITS; (value >> (msb + 1)) != 0; ++msb) {
+    ;
+  }
+  shift = msb - kHIST_SUB_BITS;
+  return (shift + 1) * kHIST_SUB_BUCKETS + (int)((value >> shift) & (kHIST_SUB_BUCKETS - 1));
 }
 
+/* The midpoint of the range of values that land in the given bucket. */
+static uint64_t rb_histogram_bucket_value(int bucket)
+{
+  int shift = 0;
+  uint64_t low = 0;
+  if (bucket < kHIST_SUB_BUCKETS) {
+    return (uint64_t)bucket;
+  }
+  shift = bucket / kHIST_SUB_BUCKETS - 1;
+  low = (uint64_t)(kHIST_SUB_BUCKETS + bucket % kHIST_SUB_BUCKETS) << shift;
+  return low + ((((uint64_t)1) << shift) >> 1);
+}
 
-
-/*
- * Polls for events. Blocks until an event occurs.
- *
- * Wraps glfwWaitEvents.
- *
- * This would likely be called at the beginning of your main loop, like so:
- *
- *    loop {
- *      Glfw.wait_events()
- *
- *      # ...
- *    }
- */
-static VALUE rb_glfw_wait_events(VALUE self)
+static void rb_histogram_record(rb_glfw_histogram_t *hist, int64_t value)
 {
-  glfwWaitEvents();
-  return self;
+  uint64_t uvalue = value > 0 ? (uint64_t)value : 0;
+  if (hist->count == 0 || uvalue < hist->min) {
+    hist->min = uvalue;
+  }
+  if (uvalue > hist->max) {
+    hist->max = uvalue;
+  }
+  hist->count += 1;
+  hist->sum += uvalue;
+  hist->counts[rb_histogram_bucket(uvalue)] += 1;
 }
 
+static uint64_t rb_histogram_percentile(const rb_glfw_histogram_t *hist, double percentile)
+{
+  uint64_t target = (uint64_t)(percentile * (double)hist->count + 0.5);
+  uint64_t seen = 0;
+  uint64_t value = 0;
+  int bucket = 0;
+
+  if (hist->count == 0) {
+    return 0;
+  }
+  if (target < 1) {
+    target = 1;
+  }
+
+  for (; bucket < kHIST_NUM_BUCKETS; ++bucket) {
+    seen += hist->counts[bucket];
+    if (seen >= target) {
+      break;
+    }
+  }
 
+  value = rb_histogram_bucket_value(bucket);
+  if (value < hist->min) {
+    value = hist->min;
+  } else if (value > hist->max) {
+    value = hist->max;
+  }
+  return value;
+}
 
 /*
- * Gets the current value for the given input mode.
- *
- * call-seq:
- *    get_input_mode(mode) -> Fixed
- *
- * Wraps glfwGetInputMode.
+ * Summarizes a histogram as a Hash of count, and min, max, mean, and
+ * percentile durations in seconds.
  */
-static VALUE rb_window_get_input_mode(VALUE self, VALUE mode)
+static VALUE rb_histogram_summary(const rb_glfw_histogram_t *hist)
 {
-  return INT2FIX(glfwGetInputMode(rb_get_window(self), NUM2INT(mode)));
+  VALUE rb_summary = rb_hash_new();
+  double mean = hist->count ? (double)hist->sum / (double)hist->count : 0.0;
+  rb_hash_aset(rb_summary, ID2SYM(rb_intern("count")), ULL2NUM(hist->count));
+  rb_hash_aset(rb_summary, ID2SYM(rb_intern("min")), rb_float_new((double)hist->min * 1e-9));
+  rb_hash_aset(rb_summary, ID2SYM(rb_intern("max")), rb_float_new((double)hist->max * 1e-9));
+  rb_hash_aset(rb_summary, ID2SYM(rb_intern("mean")), rb_float_new(mean * 1e-9));
+  rb_hash_aset(rb_summary, ID2SYM(rb_intern("p50")), rb_float_new((double)rb_histogram_percentile(hist, 0.50) * 1e-9));
+  rb_hash_aset(rb_summary, ID2SYM(rb_intern("p90")), rb_float_new((double)rb_histogram_percentile(hist, 0.90) * 1e-9));
+  rb_hash_aset(rb_summary, ID2SYM(rb_intern("p99")), rb_float_new((double)rb_histogram_percentile(hist, 0.99) * 1e-9));
+  rb_hash_aset(rb_summary, ID2SYM(rb_intern("p999")), rb_float_new((double)rb_histogram_percentile(hist, 0.999) * 1e-9));
+  return rb_summary;
 }
 
 
 
+/* Per-window frame phases tracked by Glfw.frame_stats */
+enum {
+  kFRAME_STAT_POLL = 0,
+  kFRAME_STAT_FRAME,
+  kFRAME_STAT_SWAP,
+  kFRAME_STAT_TOTAL,
+  kFRAME_STAT_COUNT
+};
+
+static const char *kFRAME_STAT_NAMES[kFRAME_STAT_COUNT] = { "poll", "frame", "swap", "total" };
+
+/* Number of recent frames kept per window for Glfw.frame_stats' :recent */
+#define kFRAME_RING_SIZE 120
+
+typedef struct rb_glfw_frame_stats {
+  int64_t last_swap_end;
+  rb_glfw_histogram_t histograms[kFRAME_STAT_COUNT];
+  int64_t ring[kFRAME_RING_SIZE][kFRAME_STAT_COUNT];
+  long ring_head;
+  long ring_length;
+} rb_glfw_frame_stats_t;
+
+static int s_frame_stats_enabled = 0;
+static int64_t s_poll_begin = 0;
+static int64_t s_poll_end = 0;
+
 /*
- * Sets the value of the given input mode.
- *
- * call-seq:
- *    set_input_mode(mode, value) -> self
- *
- * Wraps glfwSetInputMode.
+ * Records one frame for a window, given when its swap began and ended. The
+ * frame's CPU time runs from the later of the last event poll and the window's
+ * previous swap until this swap began.
  */
-static VALUE rb_window_set_input_mode(VALUE self, VALUE mode, VALUE value)
+static void rb_window_record_frame(rb_glfw_window_t *state, int64_t swap_begin, int64_t swap_end)
 {
-  glfwSetInputMode(rb_get_window(self), NUM2INT(mode), NUM2INT(value));
-  return self;
-}
+  rb_glfw_frame_stats_t *stats = state->frame_stats;
+  int64_t frame_begin = s_poll_end;
+  int64_t *sample = NULL;
+
+  if (stats == NULL) {
+    stats = state->frame_stats = ALLOC(rb_glfw_frame_stats_t);
+    MEMZERO(stats, rb_glfw_frame_stats_t, 1);
+  }
+
+  if (stats->last_swap_end > frame_begin) {
+    frame_begin = stats->last_swap_end;
+  }
 
+  sample = stats->ring[stats->ring_head];
+  sample[kFRAME_STAT_POLL] = s_poll_end - s_poll_begin;
+  sample[kFRAME_STAT_FRAME] = swap_begin - frame_begin;
+  sample[kFRAME_STAT_SWAP] = swap_end - swap_begin;
+  sample[kFRAME_STAT_TOTAL] = stats->last_swap_end ? swap_end - stats->last_swap_end : 0;
+
+  rb_histogram_record(&stats->histograms[kFRAME_STAT_POLL], sample[kFRAME_STAT_POLL]);
+  rb_histogram_record(&stats->histograms[kFRAME_STAT_FRAME], sample[kFRAME_STAT_FRAME]);
+  rb_histogram_record(&stats->histograms[kFRAME_STAT_SWAP], sample[kFRAME_STAT_SWAP]);
+  if (stats->last_swap_end) {
+    rb_histogram_record(&stats->histograms[kFRAME_STAT_TOTAL], sample[kFRAME_STAT_TOTAL]);
+  }
 
+  stats->ring_head = (stats->ring_head + 1) % kFRAME_RING_SIZE;
+  if (stats->ring_length < kFRAME_RING_SIZE) {
+    stats->ring_length += 1;
+  }
+  stats->last_swap_end = swap_end;
+}
 
 /*
- * Gets the last-reported state of the given keyboard key for the window.
- *
- * call-seq:
- *    key(key) -> Fixed
- *
- * Wraps glfwGetKey.
+ * Input latency tracking. While enabled, input trampolines stamp each event
+ * with the time it reached the binding, and each window records how long its
+ * events waited before their Ruby handler ran and how long until a swap
+ * presented them.
  */
-static VALUE rb_window_get_key(VALUE self, VALUE key)
+typedef struct rb_glfw_input_latency {
+  rb_glfw_histogram_t dispatch;
+  rb_glfw_histogram_t present;
+} rb_glfw_input_latency_t;
+
+static int s_input_latency_enabled = 0;
+
+/* Arrival time of the most recent input event, see Glfw.event_time_ns */
+static int64_t s_event_arrival = 0;
+
+static rb_glfw_input_latency_t *rb_input_latency_for(rb_glfw_window_t *state)
 {
-  return INT2FIX(glfwGetKey(rb_get_window(self), NUM2INT(key)));
+  if (state->input_latency == NULL) {
+    state->input_latency = ALLOC(rb_glfw_input_latency_t);
+    MEMZERO(state->input_latency, rb_glfw_input_latency_t, 1);
+  }
+  return state->input_latency;
 }
 
-
+/* Set by input callbacks, for Glfw::pump_events to notice input activity */
+static int s_input_seen = 0;
 
 /*
- * Gets the last-reported state of the given mouse button for the window.
+ * Stamps an input event's arrival. Returns 0 when latency tracking is off, so
+ * the rest of the trampoline can skip tracking with a single test.
+ */
+static int64_t rb_input_arrival(void)
+{
+  s_input_seen = 1;
+  if (s_input_latency_enabled) {
+    return s_event_arrival = rb_glfw_time_ns();
+  }
+  return 0;
+}
+
+/* Marks the window as having unpresented input since the given arrival. */
+static void rb_window_input_arrived(rb_glfw_window_t *state, int64_t arrival)
+{
+  if (state->input_pending_since == 0) {
+    state->input_pending_since = arrival;
+  }
+}
+
+static void rb_window_input_dispatched(rb_glfw_window_t *state, int64_t arrival)
+{
+  rb_histogram_record(&rb_input_latency_for(state)->dispatch, rb_glfw_time_ns() - arrival);
+}
+
+/*
+ * Records, once per swap, the latency from the oldest input event the swap
+ * presents until the swap completed.
+ */
+static void rb_window_input_presented(rb_glfw_window_t *state, int64_t swap_end)
+{
+  rb_histogram_record(&rb_input_latency_for(state)->present, swap_end - state->input_pending_since);
+  state->input_pending_since = 0;
+}
+
+/*
+ * Same as RB_DISPATCH_CALLBACK, but for input events stamped with
+ * rb_input_arrival. ARRIVAL is 0 if latency tracking is off.
+ */
+#define RB_DISPATCH_INPUT_CALLBACK(STATE, EVENT, ARRIVAL, CALL)               \
+  do {                                                                        \
+    if (ARRIVAL) {                                                            \
+      rb_window_input_dispatched((STATE), (ARRIVAL));                         \
+    }                                                                         \
+    RB_DISPATCH_CALLBACK(STATE, EVENT, CALL);                                 \
+  } while (0)
+
+/*
+ * Returns a descriptor that becomes readable when the windowing system has
+ * events for us, or -1 if it doesn't have one. Only X11 (and the stub) do.
+ */
+static int rb_glfw_event_fd(void)
+{
+#if defined(GLFW_STUB)
+  return glfwStubEventFd();
+#elif defined(RB_GLFW_X11)
+  Display *display = glfwGetX11Display();
+  return display ? ConnectionNumber(display) : -1;
+#else
+  return -1;
+#endif
+}
+
+
+
+/*
+ * Returns whether events were already read off the connection by an earlier
+ * call, in which case its descriptor won't become readable for them. On X11
+ * this also flushes queued requests, so replies to them can arrive.
+ */
+static int rb_glfw_events_queued(void)
+{
+#if defined(GLFW_STUB)
+  return glfwStubPendingEvents() > 0;
+#elif defined(RB_GLFW_X11)
+  Display *display = glfwGetX11Display();
+  return display ? XPending(display) > 0 : 0;
+#else
+  return 0;
+#endif
+}
+
+
+
+/*
+ * Work posted to the main thread by Glfw::post_to_main, as an Array of blocks.
+ * Run after each poll by rb_glfw_run_main_queue.
+ */
+static VALUE s_main_queue = Qnil;
+/* Self-pipe written to wake a thread waiting for events, see rb_glfw_wakeup */
+static int s_wakeup_pipe[2] = { -1, -1 };
+/* Set when the pipe may hold bytes, so polling needn't read it every time */
+static volatile int s_wakeup_signalled = 0;
+
+typedef struct rb_glfw_wait_args {
+  int event_fd;
+  int timeout_ms;
+} rb_glfw_wait_args_t;
+
+/*
+ * Creates the wakeup pipe. Without one (i.e., on Windows), only GLFW 3.1's
+ * glfwPostEmptyEvent can wake a waiting thread.
+ */
+static void rb_glfw_init_wakeup(void)
+{
+#ifndef _WIN32
+  int index = 0;
+
+  if (pipe(s_wakeup_pipe) != 0) {
+    s_wakeup_pipe[0] = s_wakeup_pipe[1] = -1;
+    return;
+  }
+
+  for (; index < 2; ++index) {
+    fcntl(s_wakeup_pipe[index], F_SETFL, fcntl(s_wakeup_pipe[index], F_GETFL) | O_NONBLOCK);
+    fcntl(s_wakeup_pipe[index], F_SETFD, FD_CLOEXEC);
+  }
+#endif
+}
+
+/*
+ * Wakes the thread waiting for events, if any, or makes its next wait return
+ * immediately. Safe to call from any thread, with or without the GVL.
+ */
+static void rb_glfw_wakeup(void)
+{
+#ifndef _WIN32
+  char byte = 0;
+  ssize_t written = 0;
+
+  if (s_wakeup_pipe[1] >= 0) {
+    s_wakeup_signalled = 1;
+    /* If the pipe's full, the waiter has plenty of wakeups already */
+    written = write(s_wakeup_pipe[1], &byte, 1);
+    (void)written;
+  }
+#endif
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 1)
+  glfwPostEmptyEvent();
+#endif
+}
+
+static void rb_glfw_drain_wakeups(void)
+{
+#ifndef _WIN32
+  char bytes[64];
+
+  s_wakeup_signalled = 0;
+  while (read(s_wakeup_pipe[0], bytes, sizeof(bytes)) > 0) {
+  }
+#endif
+}
+
+static void rb_glfw_unblock_wait(void *data)
+{
+  rb_glfw_wakeup();
+}
+
+static void *rb_glfw_wait_without_gvl(void *data)
+{
+#ifndef _WIN32
+  rb_glfw_wait_args_t *args = (rb_glfw_wait_args_t *)data;
+  struct pollfd fds[2];
+
+  fds[0].fd = args->event_fd;
+  fds[0].events = POLLIN;
+  fds[0].revents = 0;
+  fds[1].fd = s_wakeup_pipe[0];
+  fds[1].events = POLLIN;
+  fds[1].revents = 0;
+  /* Errors (including EINTR) just end the wait early */
+  poll(fds, 2, args->timeout_ms);
+#endif
+  return NULL;
+}
+
+/*
+ * Waits until the windowing system has events, rb_glfw_wakeup is called, or
+ * timeout_ms milliseconds pass (forever if negative), with the GVL released
+ * so other threads can run and post work. Doesn't process any events.
+ *
+ * Returns 0 if it can't wait this way (there's no event fd or wakeup pipe),
+ * in which case the caller should fall back to glfwWaitEvents.
+ */
+static int rb_glfw_wait_for_events(int timeout_ms)
+{
+  rb_glfw_wait_args_t args;
+
+  args.event_fd = rb_glfw_event_fd();
+  args.timeout_ms = timeout_ms;
+  if (args.event_fd < 0 || s_wakeup_pipe[0] < 0) {
+    return 0;
+  }
+
+  if (!rb_glfw_events_queued() && RARRAY_LEN(s_main_queue) == 0) {
+    rb_thread_call_without_gvl(rb_glfw_wait_without_gvl, &args, rb_glfw_unblock_wait, NULL);
+  }
+  rb_glfw_drain_wakeups();
+  return 1;
+}
+
+/*
+ * Runs the blocks queued by Glfw::post_to_main. Blocks they queue in turn run
+ * after the next poll, so a block that re-posts itself can't loop forever.
+ */
+static void rb_glfw_run_main_queue(void)
+{
+  long remaining = RARRAY_LEN(s_main_queue);
+
+  while (remaining-- > 0 && RARRAY_LEN(s_main_queue) > 0) {
+    rb_funcall(rb_ary_shift(s_main_queue), kRB_CALL, 0);
+  }
+}
+
+/*
+ * Longest nap when asked to wait with a timeout but there's no event fd to wait
+ * on, since GLFW 3.0 has no glfwWaitEventsTimeout.
+ */
+static const double kPUMP_NAP_SECONDS = 1.0 / 60.0;
+
+/* Sleeps for up to kPUMP_NAP_SECONDS with the GVL released. */
+static void rb_glfw_nap(double seconds)
+{
+  struct timeval interval;
+
+  if (seconds > kPUMP_NAP_SECONDS) {
+    seconds = kPUMP_NAP_SECONDS;
+  }
+  interval.tv_sec = (long)seconds;
+  interval.tv_usec = (long)((seconds - (double)interval.tv_sec) * 1e6);
+  rb_thread_wait_for(interval);
+}
+
+/*
+ * Flushes deferred writes, polls or waits for events, then runs work posted
+ * to the main thread. A timeout of 0 polls, a negative one waits until there
+ * are events, and a positive one waits at most that many seconds. This is the
+ * only place the binding pumps events, so it's where poll timing is recorded.
+ */
+static void rb_glfw_pump_events(double timeout)
+{
+  rb_glfw_flush_pending_writes();
+
+  if (s_frame_stats_enabled || s_trace_enabled) {
+    s_poll_begin = rb_glfw_time_ns();
+  }
+
+  /* Waiting on the event fd only waits; the events are still polled below */
+  if (timeout < 0.0 && !rb_glfw_wait_for_events(-1)) {
+    glfwWaitEvents();
+  } else {
+    if (timeout > 0.0 &&
+        !rb_glfw_wait_for_events(timeout < INT_MAX / 1000 ? (int)(timeout * 1000.0 + 0.999) : INT_MAX)) {
+      rb_glfw_nap(timeout);
+    }
+    if (s_wakeup_signalled) {
+      rb_glfw_drain_wakeups();
+    }
+    glfwPollEvents();
+  }
+
+  if (s_frame_stats_enabled || s_trace_enabled) {
+    s_poll_end = rb_glfw_time_ns();
+    if (s_trace_enabled) {
+      rb_trace_record(timeout != 0.0 ? kTRACE_WAIT_EVENTS : kTRACE_POLL_EVENTS, 0, NULL, s_poll_begin, s_poll_end);
+    }
+  }
+
+  if (RARRAY_LEN(s_main_queue) > 0) {
+    rb_glfw_run_main_queue();
+  }
+}
+
+/* Adaptive pumping, see Glfw::pump_events */
+static int s_redraw_pending = 0;
+static double s_redraw_until = 0.0;
+static int s_input_recent = 0;
+static double s_last_input_time = 0.0;
+static double s_input_linger = 0.25;
+
+/*
+ * Returns whether something needs frames drawn continuously: either recent
+ * input or a redraw deadline from Glfw::redraw_until that hasn't passed.
+ */
+static int rb_glfw_pump_active(void)
+{
+  double now = 0.0;
+
+  if (!s_redraw_pending && !s_input_recent) {
+    return 0;
+  }
+
+  /* Stays active for the call that notices the deadline passed, so the frame
+     at the deadline is drawn before waiting */
+  now = glfwGetTime();
+  if (s_redraw_pending && now >= s_redraw_until) {
+    s_redraw_pending = 0;
+    return 1;
+  }
+  if (s_input_recent && now - s_last_input_time >= s_input_linger) {
+    s_input_recent = 0;
+  }
+  return s_redraw_pending || s_input_recent;
+}
+
+/*
+ * Returns how long to wait for events before something is due at time
+ * next_due: negative (forever) if next_due is, 0 (poll) if it's passed, and
+ * otherwise at least a millisecond.
+ */
+static double rb_glfw_wait_until(double next_due)
+{
+  double wait = 0.0;
+  if (next_due < 0.0) {
+    return -1.0;
+  }
+  wait = next_due - glfwGetTime();
+  if (wait <= 0.0) {
+    return 0.0;
+  }
+  return wait < 0.001 ? 0.001 : wait;
+}
+
+/*
+ * Polls if rb_glfw_pump_active, otherwise waits for events for up to
+ * max_wait seconds (forever if negative). Returns whether it polled.
+ */
+static int rb_glfw_pump_adaptive(double max_wait)
+{
+  int active = rb_glfw_pump_active();
+
+  s_input_seen = 0;
+  rb_glfw_pump_events(active ? 0.0 : max_wait);
+  if (s_input_seen) {
+    s_input_recent = 1;
+    s_last_input_time = glfwGetTime();
+  }
+  return active;
+}
+
+
+
+/*
+ * Enables or disables per-window frame timing. While enabled, the binding
+ * timestamps event polling and buffer swaps and records, for each window,
+ * how long the last poll took, how long the frame's Ruby code ran, how long
+ * the swap (including any vsync wait) took, and the total frame time.
+ * Recording doesn't allocate. See ::frame_stats.
  *
  * call-seq:
- *    mouse_button(key) -> Fixed
+ *    frame_stats_enabled = enabled -> enabled
+ */
+static VALUE rb_glfw_set_frame_stats_enabled(VALUE self, VALUE enabled)
+{
+  s_frame_stats_enabled = RTEST(enabled);
+  return enabled;
+}
+
+
+
+/*
+ * Returns whether frame timing is enabled. See ::frame_stats_enabled=.
  *
- * Wraps glfwGetMouseButton.
+ * call-seq:
+ *    frame_stats_enabled? -> true or false
  */
-static VALUE rb_window_get_mouse_button(VALUE self, VALUE button)
+static VALUE rb_glfw_get_frame_stats_enabled(VALUE self)
 {
-  return INT2FIX(glfwGetMouseButton(rb_get_window(self), NUM2INT(button)));
+  return s_frame_stats_enabled ? Qtrue : Qfalse;
 }
 
 
 
 /*
- * Gets the last-reported cursor position in the window.
+ * Returns frame timing statistics for every window that has swapped buffers
+ * while frame timing was enabled, as a Hash of windows to Hashes keyed by
+ * :poll, :frame, :swap, and :total. Each of those holds the :count of frames
+ * and the :min, :max, :mean, :p50, :p90, :p99, and :p999 durations in
+ * seconds. Each window's Hash also has :recent, an Array of the most recent
+ * frames' [poll, frame, swap, total] durations, oldest first.
  *
  * call-seq:
- *    cursor_pos -> [x, y]
+ *    frame_stats -> { Glfw::Window => { :poll => {...}, ... }, ... }
+ */
+static VALUE rb_glfw_frame_stats(VALUE self)
+{
+  VALUE rb_windows = rb_funcall(rb_cvar_get(s_glfw_window_klass, kRB_CVAR_WINDOW_WINDOWS), rb_intern("values"), 0);
+  VALUE rb_stats = rb_hash_new();
+  long window_index = 0;
+
+  for (; window_index < RARRAY_LEN(rb_windows); ++window_index) {
+    VALUE rb_window = rb_ary_entry(rb_windows, window_index);
+    rb_glfw_window_t *state = rb_get_window_state(rb_window);
+    rb_glfw_frame_stats_t *stats = state ? state->frame_stats : NULL;
+    VALUE rb_window_stats, rb_recent;
+    long sample_index = 0;
+    int stat = 0;
+
+    if (stats == NULL) {
+      continue;
+    }
+
+    rb_window_stats = rb_hash_new();
+    for (stat = 0; stat < kFRAME_STAT_COUNT; ++stat) {
+      rb_hash_aset(rb_window_stats, ID2SYM(rb_intern(kFRAME_STAT_NAMES[stat])),
+        rb_histogram_summary(&stats->histograms[stat]));
+    }
+
+    rb_recent = rb_ary_new2(stats->ring_length);
+    for (; sample_index < stats->ring_length; ++sample_index) {
+      long ring_index = (stats->ring_head - stats->ring_length + sample_index + kFRAME_RING_SIZE) % kFRAME_RING_SIZE;
+      const int64_t *sample = stats->ring[ring_index];
+      rb_ary_push(rb_recent, rb_ary_new3(4,
+        rb_float_new((double)sample[kFRAME_STAT_POLL] * 1e-9),
+        rb_float_new((double)sample[kFRAME_STAT_FRAME] * 1e-9),
+        rb_float_new((double)sample[kFRAME_STAT_SWAP] * 1e-9),
+        rb_float_new((double)sample[kFRAME_STAT_TOTAL] * 1e-9)));
+    }
+    rb_hash_aset(rb_window_stats, ID2SYM(rb_intern("recent")), rb_recent);
+
+    rb_hash_aset(rb_stats, rb_window, rb_window_stats);
+  }
+
+  return rb_stats;
+}
+
+
+
+/*
+ * Discards all recorded frame timing statistics.
  *
- * Wraps glfwGetCursorPos.
+ * call-seq:
+ *    reset_frame_stats -> self
  */
-static VALUE rb_window_get_cursor_pos(VALUE self)
+static VALUE rb_glfw_reset_frame_stats(VALUE self)
 {
-  double xpos = 0;
-  double ypos = 0;
-  glfwGetCursorPos(rb_get_window(self), &xpos, &ypos);
-  return rb_ary_new3(2, rb_float_new(xpos), rb_float_new(ypos));
+  VALUE rb_windows = rb_funcall(rb_cvar_get(s_glfw_window_klass, kRB_CVAR_WINDOW_WINDOWS), rb_intern("values"), 0);
+  long window_index = 0;
+  for (; window_index < RARRAY_LEN(rb_windows); ++window_index) {
+    rb_glfw_window_t *state = rb_get_window_state(rb_ary_entry(rb_windows, window_index));
+    if (state && state->frame_stats) {
+      xfree(state->frame_stats);
+      state->frame_stats = NULL;
+    }
+  }
+  s_poll_begin = s_poll_end = 0;
+  return self;
 }
 
 
 
 /*
- * Sets the position of the mouse cursor relative to the client area of the
- * window. If the window isn't focused at the time of the call, this silently
- * fails.
+ * Enables or disables callback profiling. While enabled, every dispatch from
+ * GLFW into a Ruby callback is counted and timed, per event type and per
+ * window. See ::callback_stats.
  *
  * call-seq:
- *    set_cursor_pos(x, y) -> self
+ *    callback_stats_enabled = enabled -> enabled
+ */
+static VALUE rb_glfw_set_callback_stats_enabled(VALUE self, VALUE enabled)
+{
+  s_callback_stats_enabled = RTEST(enabled);
+  rb_update_dispatch_instrumented();
+  return enabled;
+}
+
+
+
+/*
+ * Returns whether callback profiling is enabled. See
+ * ::callback_stats_enabled=.
  *
- * Wraps glfwSetCursorPos.
+ * call-seq:
+ *    callback_stats_enabled? -> true or false
  */
-static VALUE rb_window_set_cursor_pos(VALUE self, VALUE x, VALUE y)
+static VALUE rb_glfw_get_callback_stats_enabled(VALUE self)
 {
-  glfwSetCursorPos(rb_get_window(self), NUM2DBL(x), NUM2DBL(y));
-  return self;
+  return s_callback_stats_enabled ? Qtrue : Qfalse;
 }
 
 
 
-static void rb_window_key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+static VALUE rb_callback_stats_summary(const rb_glfw_callback_stats_t *stats)
 {
-  VALUE rb_window = rb_lookup_window(window);
-  if (RTEST(rb_window)) {
-    VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_KEY_CALLBACK);
-    if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
-      rb_funcall(rb_func, kRB_CALL, 5, rb_window, INT2FIX(key), INT2FIX(scancode), INT2FIX(action), INT2FIX(mods));
+  VALUE rb_summary = rb_hash_new();
+  int event = 0;
+  for (; event < kCALLBACK_COUNT; ++event) {
+    VALUE rb_event;
+    if (stats->counts[event] == 0) {
+      continue;
     }
+    rb_event = rb_hash_new();
+    rb_hash_aset(rb_event, ID2SYM(rb_intern("count")), ULL2NUM(stats->counts[event]));
+    rb_hash_aset(rb_event, ID2SYM(rb_intern("time")), rb_float_new((double)stats->time[event] * 1e-9));
+    rb_hash_aset(rb_event, ID2SYM(rb_intern("max")), rb_float_new((double)stats->max_time[event] * 1e-9));
+    rb_hash_aset(rb_summary, ID2SYM(rb_intern(kCALLBACK_NAMES[event])), rb_event);
   }
+  return rb_summary;
 }
 
-RB_ENABLE_CALLBACK_DEF(rb_window_set_key_callback, rb_window_key_callback, glfwSetKeyCallback);
 
 
+/*
+ * Returns callback profiling results as a Hash. Error and monitor callbacks
+ * are reported under :global; every other callback is reported under the
+ * window it was dispatched for. Each of those maps event types (:key, :char,
+ * :mouse_button, :cursor_position, :cursor_enter, :scroll, :position, :size,
+ * :close, :refresh, :focus, :iconify, :framebuffer_size, :error, :monitor) to
+ * a Hash of the dispatch :count and the total and :max seconds spent in Ruby
+ * as :time and :max. Event types that were never dispatched are omitted.
+ *
+ * Callbacks that raise are counted but their time isn't recorded.
+ *
+ * call-seq:
+ *    callback_stats -> { :global => {...}, Glfw::Window => {...}, ... }
+ */
+static VALUE rb_glfw_callback_stats(VALUE self)
+{
+  VALUE rb_windows = rb_funcall(rb_cvar_get(s_glfw_window_klass, kRB_CVAR_WINDOW_WINDOWS), rb_intern("values"), 0);
+  VALUE rb_stats = rb_hash_new();
+  long window_index = 0;
+
+  rb_hash_aset(rb_stats, ID2SYM(rb_intern("global")), rb_callback_stats_summary(&s_global_callback_stats));
+
+  for (; window_index < RARRAY_LEN(rb_windows); ++window_index) {
+    VALUE rb_window = rb_ary_entry(rb_windows, window_index);
+    rb_glfw_window_t *state = rb_get_window_state(rb_window);
+    if (state && state->callback_stats) {
+      rb_hash_aset(rb_stats, rb_window, rb_callback_stats_summary(state->callback_stats));
+    }
+  }
+
+  return rb_stats;
+}
+
 
-static void rb_window_char_callback(GLFWwindow *window, unsigned int code)
+
+/*
+ * Discards all callback profiling results.
+ *
+ * call-seq:
+ *    reset_callback_stats -> self
+ */
+static VALUE rb_glfw_reset_callback_stats(VALUE self)
 {
-  VALUE rb_window = rb_lookup_window(window);
-  if (RTEST(rb_window)) {
-    VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_CHAR_CALLBACK);
-    if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
-      rb_funcall(rb_func, kRB_CALL, 2, rb_window, UINT2NUM(code));
+  VALUE rb_windows = rb_funcall(rb_cvar_get(s_glfw_window_klass, kRB_CVAR_WINDOW_WINDOWS), rb_intern("values"), 0);
+  long window_index = 0;
+  for (; window_index < RARRAY_LEN(rb_windows); ++window_index) {
+    rb_glfw_window_t *state = rb_get_window_state(rb_ary_entry(rb_windows, window_index));
+    if (state && state->callback_stats) {
+      xfree(state->callback_stats);
+      state->callback_stats = NULL;
     }
   }
+  MEMZERO(&s_global_callback_stats, rb_glfw_callback_stats_t, 1);
+  return self;
 }
 
-RB_ENABLE_CALLBACK_DEF(rb_window_set_char_callback, rb_window_char_callback, glfwSetCharCallback);
 
 
+/*
+ * Enables or disables input latency tracking. While enabled, every key, char,
+ * mouse button, cursor position, cursor enter, and scroll event is stamped
+ * when it reaches the binding, and each window records how long events waited
+ * until their Ruby callback ran and until the window's next buffer swap
+ * completed. See ::input_latency and ::event_time_ns.
+ *
+ * call-seq:
+ *    input_latency_enabled = enabled -> enabled
+ */
+static VALUE rb_glfw_set_input_latency_enabled(VALUE self, VALUE enabled)
+{
+  s_input_latency_enabled = RTEST(enabled);
+  return enabled;
+}
+
+
+
+/*
+ * Returns whether input latency tracking is enabled. See
+ * ::input_latency_enabled=.
+ *
+ * call-seq:
+ *    input_latency_enabled? -> true or false
+ */
+static VALUE rb_glfw_get_input_latency_enabled(VALUE self)
+{
+  return s_input_latency_enabled ? Qtrue : Qfalse;
+}
+
 
 
-static void rb_window_mouse_button_callback(GLFWwindow *window, int button, int action, int mods)
+/*
+ * Returns the time, on the ::time_ns clock, at which the most recent input
+ * event reached the binding, or nil if input latency tracking is off. Inside
+ * an input callback, this is the arrival time of the event being handled.
+ *
+ * call-seq:
+ *    event_time_ns -> Integer or nil
+ */
+static VALUE rb_glfw_event_time_ns(VALUE self)
 {
-  VALUE rb_window = rb_lookup_window(window);
-  if (RTEST(rb_window)) {
-    VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_MOUSE_BUTTON_CALLBACK);
-    if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
-      rb_funcall(rb_func, kRB_CALL, 4, rb_window, INT2FIX(button), INT2FIX(action), INT2FIX(mods));
+  return s_input_latency_enabled && s_event_arrival ? LL2NUM(s_event_arrival) : Qnil;
+}
+
+
+
+/*
+ * Returns input latency statistics as a Hash of windows to Hashes with
+ * :dispatch, the latency from each input event's arrival to its Ruby callback
+ * being called, and :present, the latency per swap from the oldest input event
+ * it presents to the swap completing. Each is summarized the same way as in
+ * ::frame_stats.
+ *
+ * call-seq:
+ *    input_latency -> { Glfw::Window => { :dispatch => {...}, :present => {...} }, ... }
+ */
+static VALUE rb_glfw_input_latency(VALUE self)
+{
+  VALUE rb_windows = rb_funcall(rb_cvar_get(s_glfw_window_klass, kRB_CVAR_WINDOW_WINDOWS), rb_intern("values"), 0);
+  VALUE rb_stats = rb_hash_new();
+  long window_index = 0;
+
+  for (; window_index < RARRAY_LEN(rb_windows); ++window_index) {
+    VALUE rb_window = rb_ary_entry(rb_windows, window_index);
+    rb_glfw_window_t *state = rb_get_window_state(rb_window);
+    VALUE rb_window_stats;
+
+    if (state == NULL || state->input_latency == NULL) {
+      continue;
     }
+
+    rb_window_stats = rb_hash_new();
+    rb_hash_aset(rb_window_stats, ID2SYM(rb_intern("dispatch")), rb_histogram_summary(&state->input_latency->dispatch));
+    rb_hash_aset(rb_window_stats, ID2SYM(rb_intern("present")), rb_histogram_summary(&state->input_latency->present));
+    rb_hash_aset(rb_stats, rb_window, rb_window_stats);
   }
+
+  return rb_stats;
 }
 
-RB_ENABLE_CALLBACK_DEF(rb_window_set_mouse_button_callback, rb_window_mouse_button_callback, glfwSetMouseButtonCallback);
 
 
+/*
+ * Discards all input latency statistics.
+ *
+ * call-seq:
+ *    reset_input_latency -> self
+ */
+static VALUE rb_glfw_reset_input_latency(VALUE self)
+{
+  VALUE rb_windows = rb_funcall(rb_cvar_get(s_glfw_window_klass, kRB_CVAR_WINDOW_WINDOWS), rb_intern("values"), 0);
+  long window_index = 0;
+  for (; window_index < RARRAY_LEN(rb_windows); ++window_index) {
+    rb_glfw_window_t *state = rb_get_window_state(rb_ary_entry(rb_windows, window_index));
+    if (state) {
+      xfree(state->input_latency);
+      state->input_latency = NULL;
+      state->input_pending_since = 0;
+    }
+  }
+  s_event_arrival = 0;
+  return self;
+}
+
+
+
+/*
+ * Starts recording a trace of the GLFW frame timeline: event polling and
+ * waiting, every callback dispatch, buffer swaps, context switches, and window
+ * creation and destruction. Spans are kept in a native ring buffer of
+ * +capacity+ entries allocated up front, so recording doesn't allocate; once
+ * it's full, the oldest spans are dropped. Any previously recorded spans are
+ * discarded. See ::write_trace.
+ *
+ * call-seq:
+ *    start_trace(capacity = 65536) -> self
+ */
+static VALUE rb_glfw_start_trace(int argc, VALUE *argv, VALUE self)
+{
+  VALUE rb_capacity;
+  long capacity = kTRACE_DEFAULT_CAPACITY;
+
+  rb_scan_args(argc, argv, "01", &rb_capacity);
+  if (!NIL_P(rb_capacity)) {
+    capacity = NUM2LONG(rb_capacity);
+    if (capacity <= 0) {
+      rb_raise(rb_eArgError, "Trace capacity must be greater than zero");
+    }
+  }
+
+  if (capacity != s_trace_capacity) {
+    REALLOC_N(s_trace_spans, rb_glfw_trace_span_t, capacity);
+    s_trace_capacity = capacity;
+  }
+  s_trace_head = 0;
+  s_trace_count = 0;
+  s_trace_enabled = 1;
+  rb_update_dispatch_instrumented();
+
+  return self;
+}
+
+
+
+/*
+ * Stops recording the trace. Spans recorded so far are kept until the next
+ * ::start_trace and can still be written with ::write_trace.
+ *
+ * call-seq:
+ *    stop_trace -> self
+ */
+static VALUE rb_glfw_stop_trace(VALUE self)
+{
+  s_trace_enabled = 0;
+  rb_update_dispatch_instrumented();
+  return self;
+}
+
+
+
+/*
+ * Returns whether a trace is being recorded. See ::start_trace.
+ *
+ * call-seq:
+ *    tracing? -> true or false
+ */
+static VALUE rb_glfw_get_tracing(VALUE self)
+{
+  return s_trace_enabled ? Qtrue : Qfalse;
+}
+
+
+
+/*
+ * Writes nanoseconds as microseconds with three decimal places, as trace-event
+ * timestamps are. Times can be negative after Glfw.time= moves the clock.
+ */
+static void rb_trace_write_micros(FILE *file, int64_t ns)
+{
+  uint64_t magnitude = ns < 0 ? (uint64_t)0 - (uint64_t)ns : (uint64_t)ns;
+  fprintf(file, "%s%llu.%03u", ns < 0 ? "-" : "",
+    (unsigned long long)(magnitude / 1000), (unsigned)(magnitude % 1000));
+}
+
+/*
+ * Writes the recorded trace to +path+ in the Chrome trace-event JSON format,
+ * which can be opened with Perfetto or chrome://tracing. Timestamps are on the
+ * same clock as ::time_ns. Spans tied to a window carry its handle as the
+ * "window" argument. Returns the number of spans written.
+ *
+ * call-seq:
+ *    write_trace(path) -> Integer
+ */
+static VALUE rb_glfw_write_trace(VALUE self, VALUE rb_path)
+{
+  FILE *file;
+  long span_index = 0;
+  long first = (s_trace_head - s_trace_count + s_trace_capacity) % (s_trace_capacity ? s_trace_capacity : 1);
+
+  FilePathValue(rb_path);
+  file = fopen(StringValueCStr(rb_path), "w");
+  if (file == NULL) {
+    rb_sys_fail(StringValueCStr(rb_path));
+  }
+
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+  for (; span_index < s_trace_count; ++span_index) {
+    const rb_glfw_trace_span_t *span = &s_trace_spans[(first + span_index) % s_trace_capacity];
+    int64_t duration = span->end - span->begin;
+    int is_callback = span->kind == kTRACE_CALLBACK;
+
+    fprintf(file,
+      "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":",
+      span_index ? ",\n" : "",
+      is_callback ? kCALLBACK_NAMES[span->event] : kTRACE_NAMES[span->kind],
+      is_callback ? "callback" : "glfw");
+    rb_trace_write_micros(file, span->begin);
+    fputs(",\"dur\":", file);
+    rb_trace_write_micros(file, duration);
+    if (span->window) {
+      fprintf(file, ",\"args\":{\"window\":\"0x%llx\"}", (unsigned long long)(uintptr_t)span->window);
+    }
+    fputc('}', file);
+  }
+  fputs("\n]}\n", file);
+
+  if (fclose(file) != 0) {
+    rb_sys_fail(StringValueCStr(rb_path));
+  }
+
+  return LONG2NUM(s_trace_count);
+}
+
+
+
+/*
+ * Polls for events without blocking until an event occurs.
+ *
+ * Wraps glfwPollEvents.
+ *
+ * This would likely be called at the beginning of your main loop, like so:
+ *
+ *    loop {
+ *      Glfw.poll_events()
+ *
+ *      # ...
+ *    }
+ */
+static VALUE rb_glfw_poll_events(VALUE self)
+{
+  rb_glfw_pump_events(0.0);
+  return self;
+}
+
+
+
+/*
+ * Polls for events. Blocks until an event occurs.
+ *
+ * Wraps glfwWaitEvents.
+ *
+ * This would likely be called at the beginning of your main loop, like so:
+ *
+ *    loop {
+ *      Glfw.wait_events()
+ *
+ *      # ...
+ *    }
+ */
+static VALUE rb_glfw_wait_events(VALUE self)
+{
+  rb_glfw_pump_events(-1.0);
+  return self;
+}
+
+
+
+/*
+ * Returns a file descriptor that becomes readable when the windowing system
+ * has events waiting, or nil if there isn't one. On X11 this is the display
+ * connection. It's for registering with an event loop; don't read from or
+ * close it. Events may already be queued when it isn't readable, so prefer
+ * ::await_events, which checks for those before waiting on it.
+ *
+ * call-seq:
+ *    event_fd -> Integer or nil
+ */
+static VALUE rb_glfw_get_event_fd(VALUE self)
+{
+  int fd = rb_glfw_event_fd();
+  return fd < 0 ? Qnil : INT2FIX(fd);
+}
+
+
+
+/*
+ * Waits for events, then polls for them like ::poll_events. Returns true once
+ * it has polled, or false if +timeout+ seconds passed first (nil waits
+ * indefinitely).
+ *
+ * Unlike ::wait_events, this doesn't block the thread: it waits on ::event_fd
+ * with the GVL released, and if a Fiber scheduler is set, through the
+ * scheduler's io_wait, so other fibers run in the meantime. This lets a
+ * window's event loop share a thread with async I/O.
+ *
+ * Where there's no event fd, it sleeps (again via the Fiber scheduler, if any)
+ * for at most a sixtieth of a second and then polls.
+ *
+ * ::post_empty_event and ::post_to_main don't interrupt this wait, since a
+ * scheduler can only wait on one descriptor per fiber; work they post runs
+ * the next time it polls.
+ *
+ * call-seq:
+ *    await_events(timeout = nil) -> true or false
+ */
+static VALUE rb_glfw_await_events(int argc, VALUE *argv, VALUE self)
+{
+  VALUE rb_timeout = Qnil;
+  struct timeval timeout;
+  double seconds = 0.0;
+  int fd = -1;
+  int ready = 0;
+
+  rb_scan_args(argc, argv, "01", &rb_timeout);
+  if (RTEST(rb_timeout)) {
+    seconds = NUM2DBL(rb_timeout);
+    if (seconds < 0.0) {
+      seconds = 0.0;
+    }
+  }
+
+  fd = rb_glfw_event_fd();
+  if (fd < 0) {
+    double interval = kPUMP_NAP_SECONDS;
+    if (RTEST(rb_timeout) && seconds < interval) {
+      interval = seconds;
+    }
+    rb_funcall(rb_mKernel, kRB_SLEEP, 1, rb_float_new(interval));
+    rb_glfw_pump_events(0.0);
+    return Qtrue;
+  }
+
+  /* Apply deferred writes now rather than after the wait */
+  rb_glfw_flush_pending_writes();
+
+  if (!rb_glfw_events_queued() && RARRAY_LEN(s_main_queue) == 0) {
+    timeout.tv_sec = (long)seconds;
+    timeout.tv_usec = (long)((seconds - (double)timeout.tv_sec) * 1e6);
+    ready = rb_wait_for_single_fd(fd, RB_WAITFD_IN, RTEST(rb_timeout) ? &timeout : NULL);
+    if (ready < 0) {
+      rb_sys_fail("event_fd");
+    } else if (ready == 0) {
+      return Qfalse;
+    }
+  }
+
+  rb_glfw_pump_events(0.0);
+  return Qtrue;
+}
+
+
+
+/*
+ * Wakes a thread blocked in ::wait_events (or Glfw::run with poll: :wait), or
+ * makes its next wait return immediately. Can be called from any thread.
+ *
+ * GLFW 3.0 has no glfwPostEmptyEvent, so this works by waiting on ::event_fd
+ * and a pipe of the binding's own instead of calling glfwWaitEvents, with the
+ * GVL released so other threads can run in the meantime. Where there's no
+ * event fd, it needs GLFW 3.1 or later to have any effect.
+ *
+ * call-seq:
+ *    post_empty_event -> self
+ */
+static VALUE rb_glfw_post_empty_event(VALUE self)
+{
+  rb_glfw_wakeup();
+  return self;
+}
+
+
+
+/*
+ * Queues the block to run on the thread pumping events, after its next poll
+ * or wait, and wakes that thread (see ::post_empty_event). Use this from
+ * worker threads for anything that has to happen on the main thread, such as
+ * creating windows or uploading data loaded in the background. Blocks run in
+ * the order they were posted; an exception raised by one propagates out of the
+ * poll that ran it and leaves the rest queued.
+ *
+ * call-seq:
+ *    post_to_main { ... } -> self
+ */
+static VALUE rb_glfw_post_to_main(VALUE self)
+{
+  rb_need_block();
+  rb_ary_push(s_main_queue, rb_block_proc());
+  rb_glfw_wakeup();
+  return self;
+}
+
+
+
+/*
+ * Polls for events while the application is active, and waits for them while
+ * it's idle, so an idle application uses next to no CPU without animations
+ * stalling. It's active while a deadline given to ::redraw_until hasn't passed
+ * and for ::input_linger seconds after input reaches any key, character,
+ * mouse button, cursor, or scroll callback.
+ *
+ * When idle, this waits for events with the GVL released, for at most
+ * +max_wait+ seconds (nil doesn't limit the wait), and no later than the next
+ * frame a window's throttle policy or on-demand mode (see
+ * Glfw::Window#unfocused_hz= and Glfw::Window#render_on_demand=) makes due.
+ * Returns true if it polled and false if it waited.
+ *
+ * call-seq:
+ *    pump_events(max_wait = nil) -> true or false
+ *
+ * For example:
+ *
+ *    loop {
+ *      Glfw.pump_events
+ *      Glfw.redraw_until(Glfw.time + 0.3) if animating
+ *      # Draw
+ *      window.swap_buffers
+ *    }
+ */
+static VALUE rb_glfw_pump_events_adaptive(int argc, VALUE *argv, VALUE self)
+{
+  VALUE rb_max_wait = Qnil;
+  double max_wait = -1.0;
+
+  double wait = 0.0;
+
+  rb_scan_args(argc, argv, "01", &rb_max_wait);
+  if (RTEST(rb_max_wait)) {
+    max_wait = NUM2DBL(rb_max_wait);
+    if (max_wait < 0.0) {
+      max_wait = 0.0;
+    }
+  }
+
+  wait = rb_glfw_wait_until(rb_glfw_next_wake_time());
+  if (max_wait >= 0.0 && (wait < 0.0 || max_wait < wait)) {
+    wait = max_wait;
+  }
+  return rb_glfw_pump_adaptive(wait) ? Qtrue : Qfalse;
+}
+
+
+
+/*
+ * Keeps ::pump_events polling until at least the given time, as returned by
+ * ::time, e.g. for the length of an animation. Never brings an existing
+ * deadline forward.
+ *
+ * call-seq:
+ *    redraw_until(time) -> self
+ */
+static VALUE rb_glfw_redraw_until(VALUE self, VALUE rb_time)
+{
+  double time = NUM2DBL(rb_time);
+  if (!s_redraw_pending || time > s_redraw_until) {
+    s_redraw_until = time;
+  }
+  s_redraw_pending = 1;
+  return self;
+}
+
+
+
+/*
+ * Returns the deadline ::pump_events is polling until, or nil if there isn't
+ * one. See ::redraw_until.
+ *
+ * call-seq:
+ *    redraw_deadline -> Float or nil
+ */
+static VALUE rb_glfw_get_redraw_deadline(VALUE self)
+{
+  rb_glfw_pump_active();
+  return s_redraw_pending ? rb_float_new(s_redraw_until) : Qnil;
+}
+
+
+
+/*
+ * Sets how many seconds ::pump_events keeps polling after input arrives.
+ * Defaults to 0.25.
+ *
+ * call-seq:
+ *    input_linger = seconds -> seconds
+ */
+static VALUE rb_glfw_set_input_linger(VALUE self, VALUE rb_seconds)
+{
+  double seconds = NUM2DBL(rb_seconds);
+  if (seconds < 0.0) {
+    rb_raise(rb_eArgError, "input_linger must not be negative");
+  }
+  s_input_linger = seconds;
+  return rb_seconds;
+}
+
+
+
+/*
+ * Returns how many seconds ::pump_events keeps polling after input arrives.
+ *
+ * call-seq:
+ *    input_linger -> Float
+ */
+static VALUE rb_glfw_get_input_linger(VALUE self)
+{
+  return rb_float_new(s_input_linger);
+}
+
+
+
+/*
+ * Gets the current value for the given input mode.
+ *
+ * call-seq:
+ *    get_input_mode(mode) -> Fixed
+ *
+ * Wraps glfwGetInputMode.
+ */
+static VALUE rb_window_get_input_mode(VALUE self, VALUE mode)
+{
+  return INT2FIX(glfwGetInputMode(rb_get_window(self), NUM2INT(mode)));
+}
+
+
+
+/*
+ * Sets the value of the given input mode.
+ *
+ * call-seq:
+ *    set_input_mode(mode, value) -> self
+ *
+ * Wraps glfwSetInputMode.
+ */
+static VALUE rb_window_set_input_mode(VALUE self, VALUE mode, VALUE value)
+{
+  glfwSetInputMode(rb_get_window(self), NUM2INT(mode), NUM2INT(value));
+  return self;
+}
+
+
+
+/*
+ * Gets the last-reported state of the given keyboard key for the window.
+ *
+ * call-seq:
+ *    key(key) -> Fixed
+ *
+ * Wraps glfwGetKey.
+ */
+static VALUE rb_window_get_key(VALUE self, VALUE key)
+{
+  return INT2FIX(glfwGetKey(rb_get_window(self), NUM2INT(key)));
+}
+
+
+
+/*
+ * Gets the last-reported state of the given mouse button for the window.
+ *
+ * call-seq:
+ *    mouse_button(key) -> Fixed
+ *
+ * Wraps glfwGetMouseButton.
+ */
+static VALUE rb_window_get_mouse_button(VALUE self, VALUE button)
+{
+  return INT2FIX(glfwGetMouseButton(rb_get_window(self), NUM2INT(button)));
+}
+
+
+
+/*
+ * Gets the last-reported cursor position in the window.
+ *
+ * call-seq:
+ *    cursor_pos -> [x, y]
+ *
+ * Wraps glfwGetCursorPos.
+ */
+static VALUE rb_window_get_cursor_pos(VALUE self)
+{
+  double xpos = 0;
+  double ypos = 0;
+  glfwGetCursorPos(rb_get_window(self), &xpos, &ypos);
+  return rb_ary_new3(2, rb_float_new(xpos), rb_float_new(ypos));
+}
+
+
+
+/*
+ * Same as #cursor_pos, but stores the cursor position in the first two
+ * elements of the given array instead of allocating a new one.
+ *
+ * call-seq:
+ *    get_cursor_pos_into(ary) -> ary
+ *
+ * Wraps glfwGetCursorPos.
+ */
+static VALUE rb_window_get_cursor_pos_into(VALUE self, VALUE rb_out)
+{
+  double xpos = 0;
+  double ypos = 0;
+  glfwGetCursorPos(rb_get_window(self), &xpos, &ypos);
+  return rb_store_pair(rb_out, rb_float_new(xpos), rb_float_new(ypos));
+}
+
+
+
+/*
+ * Sets the position of the mouse cursor relative to the client area of the
+ * window. If the window isn't focused at the time of the call, this silently
+ * fails.
+ *
+ * call-seq:
+ *    set_cursor_pos(x, y) -> self
+ *
+ * Wraps glfwSetCursorPos.
+ */
+static VALUE rb_window_set_cursor_pos(VALUE self, VALUE x, VALUE y)
+{
+  glfwSetCursorPos(rb_get_window(self), NUM2DBL(x), NUM2DBL(y));
+  return self;
+}
+
+
+
+static void rb_window_key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+  int64_t arrival = rb_input_arrival();
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  VALUE rb_window = state ? state->rb_window : Qnil;
+  if (RTEST(rb_window)) {
+    VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_KEY_CALLBACK);
+    if (s_event_log) {
+      rb_record_ints(state, kCALLBACK_KEY, key, scancode, action, mods);
+    }
+    if (arrival) {
+      rb_window_input_arrived(state, arrival);
+    }
+    if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
+      RB_DISPATCH_INPUT_CALLBACK(state, kCALLBACK_KEY, arrival,
+        rb_funcall(rb_func, kRB_CALL, 5, rb_window, INT2FIX(key), INT2FIX(scancode), INT2FIX(action), INT2FIX(mods)));
+    }
+  }
+}
+
+RB_ENABLE_CALLBACK_DEF(rb_window_set_key_callback, rb_window_key_callback, glfwSetKeyCallback);
+
+
+
+static void rb_window_char_callback(GLFWwindow *window, unsigned int code)
+{
+  int64_t arrival = rb_input_arrival();
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  VALUE rb_window = state ? state->rb_window : Qnil;
+  if (RTEST(rb_window)) {
+    VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_CHAR_CALLBACK);
+    if (s_event_log) {
+      rb_record_ints(state, kCALLBACK_CHAR, (int)code, 0, 0, 0);
+    }
+    if (arrival) {
+      rb_window_input_arrived(state, arrival);
+    }
+    if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
+      RB_DISPATCH_INPUT_CALLBACK(state, kCALLBACK_CHAR, arrival,
+        rb_funcall(rb_func, kRB_CALL, 2, rb_window, UINT2NUM(code)));
+    }
+  }
+}
+
+RB_ENABLE_CALLBACK_DEF(rb_window_set_char_callback, rb_window_char_callback, glfwSetCharCallback);
+
+
+
+
+static void rb_window_mouse_button_callback(GLFWwindow *window, int button, int action, int mods)
+{
+  int64_t arrival = rb_input_arrival();
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  VALUE rb_window = state ? state->rb_window : Qnil;
+  if (RTEST(rb_window)) {
+    VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_MOUSE_BUTTON_CALLBACK);
+    if (s_event_log) {
+      rb_record_ints(state, kCALLBACK_MOUSE_BUTTON, button, action, mods, 0);
+    }
+    if (arrival) {
+      rb_window_input_arrived(state, arrival);
+    }
+    if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
+      RB_DISPATCH_INPUT_CALLBACK(state, kCALLBACK_MOUSE_BUTTON, arrival,
+        rb_funcall(rb_func, kRB_CALL, 4, rb_window, INT2FIX(button), INT2FIX(action), INT2FIX(mods)));
+    }
+  }
+}
+
+RB_ENABLE_CALLBACK_DEF(rb_window_set_mouse_button_callback, rb_window_mouse_button_callback, glfwSetMouseButtonCallback);
+
+
+
+static void rb_window_cursor_position_callback(GLFWwindow *window, double x, double y)
+{
+  int64_t arrival = rb_input_arrival();
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  VALUE rb_window = state ? state->rb_window : Qnil;
+  if (RTEST(rb_window)) {
+    VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_CURSOR_POSITION_CALLBACK);
+    if (s_event_log) {
+      rb_record_doubles(state, kCALLBACK_CURSOR_POSITION, x, y);
+    }
+    if (arrival) {
+      rb_window_input_arrived(state, arrival);
+    }
+    if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
+      RB_DISPATCH_INPUT_CALLBACK(state, kCALLBACK_CURSOR_POSITION, arrival,
+        rb_funcall(rb_func, kRB_CALL, 3, rb_window, rb_float_new(x), rb_float_new(y)));
+    }
+  }
+}
+
+RB_ENABLE_CALLBACK_DEF(rb_window_set_cursor_position_callback, rb_window_cursor_position_callback, glfwSetCursorPosCallback);
+
+
+
+static void rb_window_cursor_enter_callback(GLFWwindow *window, int entered)
+{
+  int64_t arrival = rb_input_arrival();
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  VALUE rb_window = state ? state->rb_window : Qnil;
+  if (RTEST(rb_window)) {
+    VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_CURSOR_ENTER_CALLBACK);
+    if (s_event_log) {
+      rb_record_ints(state, kCALLBACK_CURSOR_ENTER, entered, 0, 0, 0);
+    }
+    if (arrival) {
+      rb_window_input_arrived(state, arrival);
+    }
+    if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
+      RB_DISPATCH_INPUT_CALLBACK(state, kCALLBACK_CURSOR_ENTER, arrival,
+        rb_funcall(rb_func, kRB_CALL, 2, rb_window, entered ? Qtrue : Qfalse));
+    }
+  }
+}
+
+RB_ENABLE_CALLBACK_DEF(rb_window_set_cursor_enter_callback, rb_window_cursor_enter_callback, glfwSetCursorEnterCallback);
+
+
+
+static void rb_window_scroll_callback(GLFWwindow *window, double x, double y)
+{
+  int64_t arrival = rb_input_arrival();
+  rb_glfw_window_t *state = rb_lookup_window_state(window);
+  VALUE rb_window = state ? state->rb_window : Qnil;
+  if (RTEST(rb_window)) {
+    VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_SCROLL_CALLBACK);
+    if (s_event_log) {
+      rb_record_doubles(state, kCALLBACK_SCROLL, x, y);
+    }
+    if (arrival) {
+      rb_window_input_arrived(state, arrival);
+    }
+    if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
+      RB_DISPATCH_INPUT_CALLBACK(state, kCALLBACK_SCROLL, arrival,
+        rb_funcall(rb_func, kRB_CALL, 3, rb_window, rb_float_new(x), rb_float_new(y)));
+    }
+  }
+}
+
+RB_ENABLE_CALLBACK_DEF(rb_window_set_scroll_callback, rb_window_scroll_callback, glfwSetScrollCallback);
+
+
+
+/*
+ * Starts recording window events to the file at +path+, replacing any existing
+ * file. Every key, char, mouse button, cursor position, cursor enter, scroll,
+ * position, size, close, refresh, focus, iconify, and framebuffer size event
+ * that reaches the binding is appended to it with its time, window, and
+ * arguments, whether or not a Ruby callback is set for it. Only events GLFW
+ * delivers to the binding are seen, so enable the callbacks you want recorded.
+ *
+ * Windows are identified in the recording by the order they were created in:
+ * windows already open are numbered first, then windows created while
+ * recording. See ::replay_events.
+ *
+ * Raises RuntimeError if already recording or replaying events.
+ *
+ * call-seq:
+ *    start_recording(path) -> self
+ */
+static VALUE rb_glfw_start_recording(VALUE self, VALUE rb_path)
+{
+  VALUE rb_windows = rb_funcall(rb_cvar_get(s_glfw_window_klass, kRB_CVAR_WINDOW_WINDOWS), rb_intern("values"), 0);
+  rb_glfw_event_log_header_t header;
+  long window_index = 0;
+  FILE *file;
+
+  if (s_event_log) {
+    rb_raise(rb_eRuntimeError, "Already recording events");
+  }
+  if (s_replaying) {
+    rb_raise(rb_eRuntimeError, "Can't record events while replaying");
+  }
+
+  FilePathValue(rb_path);
+  file = fopen(StringValueCStr(rb_path), "wb");
+  if (file == NULL) {
+    rb_sys_fail(StringValueCStr(rb_path));
+  }
+
+  MEMCPY(header.magic, kEVENT_LOG_MAGIC, char, sizeof(header.magic));
+  header.version = kEVENT_LOG_VERSION;
+  header.record_size = (uint32_t)sizeof(rb_glfw_event_record_t);
+  if (fwrite(&header, sizeof(header), 1, file) != 1) {
+    fclose(file);
+    rb_sys_fail(StringValueCStr(rb_path));
+  }
+
+  s_event_log_windows = 0;
+  for (; window_index < RARRAY_LEN(rb_windows); ++window_index) {
+    rb_glfw_window_t *state = rb_get_window_state(rb_ary_entry(rb_windows, window_index));
+    if (state) {
+      state->record_id = ++s_event_log_windows;
+    }
+  }
+
+  s_event_log_start = rb_glfw_time_ns();
+  s_event_log_error = 0;
+  s_event_log = file;
+
+  return self;
+}
+
+
+
+/*
+ * Stops recording events and closes the recording. Does nothing if not
+ * recording. Raises SystemCallError if writing the recording failed (e.g.,
+ * the disk filled up), in which case it's incomplete: it holds the events up
+ * to the failure.
+ *
+ * call-seq:
+ *    stop_recording -> self
+ */
+static VALUE rb_glfw_stop_recording(VALUE self)
+{
+  FILE *file = s_event_log;
+  int error = s_event_log_error;
+  if (file) {
+    s_event_log = NULL;
+    s_event_log_error = 0;
+    if (fclose(file) != 0 && error == 0) {
+      error = errno ? errno : EIO;
+    }
+    if (error != 0) {
+      rb_syserr_fail(error, "stop_recording: the recording is incomplete");
+    }
+  }
+  return self;
+}
+
+
+
+/*
+ * Returns whether events are being recorded. See ::start_recording.
+ *
+ * call-seq:
+ *    recording? -> true or false
+ */
+static VALUE rb_glfw_get_recording(VALUE self)
+{
+  return s_event_log ? Qtrue : Qfalse;
+}
+
+
+
+typedef struct rb_glfw_replay {
+  FILE *file;
+  VALUE rb_windows;
+  int realtime;
+  long count;
+} rb_glfw_replay_t;
+
+static void rb_glfw_replay_record(const rb_glfw_event_record_t *record, GLFWwindow *window)
+{
+  const int32_t *i = record->args.i;
+  const double *d = record->args.d;
+
+  switch (record->event) {
+  case kCALLBACK_KEY:              rb_window_key_callback(window, i[0], i[1], i[2], i[3]); break;
+  case kCALLBACK_CHAR:             rb_window_char_callback(window, (unsigned int)i[0]); break;
+  case kCALLBACK_MOUSE_BUTTON:     rb_window_mouse_button_callback(window, i[0], i[1], i[2]); break;
+  case kCALLBACK_CURSOR_POSITION:  rb_window_cursor_position_callback(window, d[0], d[1]); break;
+  case kCALLBACK_CURSOR_ENTER:     rb_window_cursor_enter_callback(window, i[0]); break;
+  case kCALLBACK_SCROLL:           rb_window_scroll_callback(window, d[0], d[1]); break;
+  case kCALLBACK_POSITION:         rb_window_window_position_callback(window, i[0], i[1]); break;
+  case kCALLBACK_SIZE:             rb_window_window_size_callback(window, i[0], i[1]); break;
+  case kCALLBACK_CLOSE:            rb_window_close_callback(window); break;
+  case kCALLBACK_REFRESH:          rb_window_refresh_callback(window); break;
+  case kCALLBACK_FOCUS:            rb_window_focus_callback(window, i[0]); break;
+  case kCALLBACK_ICONIFY:          rb_window_iconify_callback(window, i[0]); break;
+  case kCALLBACK_FRAMEBUFFER_SIZE: rb_window_fbsize_callback(window, i[0], i[1]); break;
+  default:
+    rb_raise(rb_eArgError, "Unknown event type %d in recording", (int)record->event);
+  }
+}
+
+static VALUE rb_glfw_replay_body(VALUE arg)
+{
+  rb_glfw_replay_t *replay = (rb_glfw_replay_t *)arg;
+  rb_glfw_event_log_header_t header;
+  rb_glfw_event_record_t record;
+  int64_t start = rb_glfw_time_ns();
+
+  if (fread(&header, sizeof(header), 1, replay->file) != 1 ||
+      memcmp(header.magic, kEVENT_LOG_MAGIC, sizeof(header.magic)) != 0) {
+    rb_raise(rb_eArgError, "Not an event recording");
+  }
+  if (header.version != kEVENT_LOG_VERSION || header.record_size != sizeof(record)) {
+    rb_raise(rb_eArgError, "Unsupported event recording version or byte order");
+  }
+
+  while (fread(&record, sizeof(record), 1, replay->file) == 1) {
+    rb_glfw_window_t *state;
+
+    if (record.window == 0 || (long)record.window > RARRAY_LEN(replay->rb_windows)) {
+      rb_raise(rb_eArgError, "Recording refers to window %u, but only %ld windows were given",
+        (unsigned int)record.window, RARRAY_LEN(replay->rb_windows));
+    }
+
+    if (replay->realtime) {
+      int64_t ahead = start + record.time - rb_glfw_time_ns();
+      if (ahead > 0) {
+        rb_thread_wait_for(rb_time_timeval(rb_float_new((double)ahead * 1e-9)));
+      }
+    }
+
+    /* Windows destroyed since (or while) replaying just drop their events */
+    state = rb_get_window_state(rb_ary_entry(replay->rb_windows, (long)record.window - 1));
+    if (state) {
+      rb_glfw_replay_record(&record, state->handle);
+      replay->count += 1;
+    }
+  }
+
+  if (ferror(replay->file)) {
+    rb_sys_fail("replay_events");
+  }
+
+  return Qnil;
+}
+
+static VALUE rb_glfw_replay_close(VALUE arg)
+{
+  --s_replaying;
+  fclose(((rb_glfw_replay_t *)arg)->file);
+  return Qnil;
+}
+
+/*
+ * Replays a recording made with ::start_recording. Each recorded event is fed
+ * through the same path as a live event, so it updates the target window's
+ * cached state, is counted by the profilers, and calls the window's Ruby
+ * callback if one is set. No events are polled, so this works without input
+ * from the windowing system.
+ *
+ * +windows+ maps the recording's windows to live ones: the first window in the
+ * recording is replayed into windows[0], and so on (see ::start_recording for
+ * how windows are numbered). If realtime is true, events are delivered with
+ * their original spacing; otherwise they're delivered as fast as possible.
+ * Returns the number of events replayed.
+ *
+ * Replayed events would be recorded again, so this raises RuntimeError while
+ * recording, and ::start_recording raises while this is replaying.
+ *
+ * call-seq:
+ *    replay_events(path, windows, realtime: false) -> Integer
+ */
+static VALUE rb_glfw_replay_events(int argc, VALUE *argv, VALUE self)
+{
+  VALUE rb_path, rb_windows, rb_options;
+  ID kwarg_ids[1];
+  VALUE kwargs[1];
+  rb_glfw_replay_t replay;
+
+  rb_scan_args(argc, argv, "2:", &rb_path, &rb_windows, &rb_options);
+  Check_Type(rb_windows, T_ARRAY);
+  if (s_event_log) {
+    rb_raise(rb_eRuntimeError, "Can't replay events while recording");
+  }
+
+  kwarg_ids[0] = kRB_REALTIME;
+  kwargs[0] = Qundef;
+  if (!NIL_P(rb_options)) {
+    rb_get_kwargs(rb_options, kwarg_ids, 0, 1, kwargs);
+  }
+
+  FilePathValue(rb_path);
+  replay.file = fopen(StringValueCStr(rb_path), "rb");
+  if (replay.file == NULL) {
+    rb_sys_fail(StringValueCStr(rb_path));
+  }
+  replay.rb_windows = rb_windows;
+  replay.realtime = kwargs[0] != Qundef && RTEST(kwargs[0]);
+  replay.count = 0;
+
+  ++s_replaying;
+  rb_ensure(rb_glfw_replay_body, (VALUE)&replay, rb_glfw_replay_close, (VALUE)&replay);
+
+  return LONG2NUM(replay.count);
+}
+
+
+
+/*
+ * Returns whether the given joystick is present.
+ *
+ * call-seq:
+ *    joystick_present?(joystick) -> true or false
+ *
+ * Wraps glfwJoystickPresent.
+ */
+static VALUE rb_glfw_joystick_present(VALUE self, VALUE joystick)
+{
+  return glfwJoystickPresent(NUM2INT(joystick)) ? Qtrue : Qfalse;
+}
+
+
+
+/*
+ * Gets the values of all axes of the given joystick. Returns nil if the
+ * joystick isn't present. See #joystick_present?.
+ *
+ * call-seq:
+ *    joystick_axes(joystick) -> [Float, ...] or nil
+ *
+ * Wraps glfwGetJoystickAxes.
+ */
+static VALUE rb_glfw_get_joystick_axes(VALUE self, VALUE joystick)
+{
+  VALUE rb_axes = Qnil;
+  int num_axes = 0;
+  int axis_index = 0;
+  const float *axes = glfwGetJoystickAxes(NUM2INT(joystick), &num_axes);
+  if (num_axes > 0) {
+    rb_axes = rb_ary_new();
+    for (; axis_index < num_axes; ++axis_index) {
+      rb_ary_push(rb_axes, rb_float_new(axes[axis_index]));
+    }
+  }
+  return rb_axes;
+}
+
+
+
+/*
+ * Gets the button values of the given joystick. Returns nil if the joystick
+ * isn't present. See #joystick_present?.
+ *
+ * call-seq:
+ *    joystick_buttons(joystick) -> [Fixed, ...] or nil
+ *
+ * Wraps glfwGetJoystickButtons.
+ */
+static VALUE rb_glfw_get_joystick_buttons(VALUE self, VALUE joystick)
+{
+  VALUE rb_buttons = Qnil;
+  int num_buttons = 0;
+  int button_index = 0;
+  const unsigned char *buttons = glfwGetJoystickButtons(NUM2INT(joystick), &num_buttons);
+  if (num_buttons > 0) {
+    rb_buttons = rb_ary_new();
+    for (; button_index < num_buttons; ++button_index) {
+      rb_ary_push(rb_buttons, rb_float_new(INT2FIX((int)buttons[button_index])));
+    }
+  }
+  return rb_buttons;
+}
+
+
+
+/*
+ * Returns the name of the given joystick.
+ *
+ * call-seq:
+ *    joystick_name(joystick) -> String
+ *
+ * Wraps glfwGetJoystickName.
+ */
+static VALUE rb_glfw_get_joystick_name(VALUE self, VALUE joystick)
+{
+  const char *joy_name = glfwGetJoystickName(NUM2INT(joystick));
+  if (joy_name) {
+    return rb_str_new2(joy_name);
+  } else {
+    return Qnil;
+  }
+}
+
+
+
+/*
+ * Sets the system clipboard string. The window this is set for will own the
+ * given string.
+ *
+ * call-seq:
+ *    clipboard_string=(string) -> String
+ *    clipboard_string = string -> String
+ *
+ * Wraps glfwSetClipboardString.
+ */
+static VALUE rb_window_set_clipboard_string(VALUE self, VALUE string)
+{
+  glfwSetClipboardString(rb_get_window(self), StringValueCStr(string));
+  return string;
+}
+
+
+
+/*
+ * Gets the system clipboard's contents as a string. The window this is called
+ * from will request the clipboard contents.
+ *
+ * call-seq:
+ *    clipboard_string() -> String
+ *
+ * Wraps glfwGetClipboardString.
+ */
+static VALUE rb_window_get_clipboard_string(VALUE self)
+{
+  return rb_str_new2(glfwGetClipboardString(rb_get_window(self)));
+}
+
+
+
+/*
+ * Gets the current time in seconds. The returned time is relative to the time
+ * since GLFW was initialized unless the time has been set using #timer=.
+ *
+ * call-seq:
+ *    time -> Float
+ *
+ * Wraps glfwGetTime.
+ */
+static VALUE rb_glfw_get_time(VALUE self)
+{
+  return rb_float_new(glfwGetTime());
+}
+
+
+
+/*
+ * Sets the current time in seconds. If set, GLFW will continue measuring time
+ * elapsed from that time forward.
+ *
+ * In most cases, you will not need to use this.
+ *
+ * call-seq:
+ *    time = Float
+ *
+ * Wraps glfwSetTime.
+ */
+static VALUE rb_glfw_set_time(VALUE self, VALUE time_)
+{
+  double seconds = NUM2DBL(time_);
+  glfwSetTime(seconds);
+  rb_glfw_reset_timer_ns((int64_t)(seconds * 1e9));
+  return time_;
+}
+
+
+
+/*
+ * Gets the current time in integer nanoseconds, on the same clock as #time
+ * but without the precision lost by a double after long uptimes. Use this for
+ * computing exact intervals.
+ *
+ * call-seq:
+ *    time_ns -> Integer
+ */
+static VALUE rb_glfw_get_time_ns(VALUE self)
+{
+  return LL2NUM(rb_glfw_time_ns());
+}
+
+
+
+/*
+ * Sets the current time in integer nanoseconds. Like #time=, this affects
+ * both #time and #time_ns.
+ *
+ * call-seq:
+ *    time_ns = Integer
+ */
+static VALUE rb_glfw_set_time_ns(VALUE self, VALUE time_ns)
+{
+  int64_t nanoseconds = NUM2LL(time_ns);
+  glfwSetTime((double)nanoseconds * 1e-9);
+  rb_glfw_reset_timer_ns(nanoseconds);
+  return time_ns;
+}
+
+
+
+/*
+ * Gets the raw value of the monotonic counter behind #time_ns, in units of
+ * 1 / #timer_frequency seconds.
+ *
+ * call-seq:
+ *    timer_value -> Integer
+ *
+ * Wraps glfwGetTimerValue where available.
+ */
+static VALUE rb_glfw_get_timer_value(VALUE self)
+{
+  return ULL2NUM(rb_glfw_timer_value());
+}
+
+
+
+/*
+ * Gets the frequency, in Hz, of the counter returned by #timer_value.
+ *
+ * call-seq:
+ *    timer_frequency -> Integer
+ *
+ * Wraps glfwGetTimerFrequency where available.
+ */
+static VALUE rb_glfw_get_timer_frequency(VALUE self)
+{
+  return ULL2NUM(rb_glfw_timer_frequency());
+}
+
+
+
+/* Native state for a Glfw::Clock. All times are in nanoseconds. */
+typedef struct rb_glfw_clock {
+  int64_t step;
+  int64_t accumulator;
+  int64_t last_time;
+  long max_steps;
+  long total_steps;
+  int paused;
+} rb_glfw_clock_t;
+
+/*
+ * Reads the timer in whole nanoseconds. Reading the absolute time every call
+ * (rather than summing float deltas) keeps clocks from drifting.
+ */
+static int64_t rb_glfw_clock_now(void)
+{
+  return rb_glfw_time_ns();
+}
+
+static VALUE rb_glfw_clock_alloc(VALUE klass)
+{
+  rb_glfw_clock_t *clock = NULL;
+  return Data_Make_Struct(klass, rb_glfw_clock_t, 0, -1, clock);
+}
+
+/* Gets the clock's state, raising if #initialize hasn't set it up. */
+static rb_glfw_clock_t *rb_get_clock(VALUE self)
+{
+  rb_glfw_clock_t *clock = NULL;
+  Data_Get_Struct(self, rb_glfw_clock_t, clock);
+  if (clock->step == 0) {
+    rb_raise(rb_eRuntimeError, "uninitialized Clock");
+  }
+  return clock;
+}
+
+
+
+/*
+ * Creates a fixed-timestep clock driven by the GLFW timer. Each call to #tick
+ * accumulates the time elapsed since the previous tick and returns how many
+ * steps of step seconds to simulate. At most max_steps are returned per tick;
+ * any further backlog is dropped so a slow frame can't snowball into ever
+ * slower frames.
+ *
+ * call-seq:
+ *    new(step, max_steps = 8) -> Glfw::Clock
+ *
+ * For example:
+ *
+ *    clock = Glfw::Clock.new(1.0 / 120)
+ *    loop {
+ *      Glfw.poll_events
+ *      clock.tick.times { simulate(clock.step) }
+ *      render(clock.alpha)
+ *      window.swap_buffers
+ *    }
+ */
+static VALUE rb_glfw_clock_initialize(int argc, VALUE *argv, VALUE self)
+{
+  rb_glfw_clock_t *clock = NULL;
+  VALUE rb_step, rb_max_steps;
+  double step;
+  long max_steps;
+
+  Data_Get_Struct(self, rb_glfw_clock_t, clock);
+  rb_scan_args(argc, argv, "11", &rb_step, &rb_max_steps);
+
+  step = NUM2DBL(rb_step);
+  if (!(step * 1e9 >= 1.0)) {
+    rb_raise(rb_eArgError, "step must be at least one nanosecond");
+  }
+  /* 2^63 nanoseconds, the first value int64_t can't hold; fails for NaN and infinity too */
+  if (!(step * 1e9 < 9223372036854775808.0)) {
+    rb_raise(rb_eArgError, "step is too large");
+  }
+  max_steps = NIL_P(rb_max_steps) ? 8 : NUM2LONG(rb_max_steps);
+  if (max_steps < 1) {
+    rb_raise(rb_eArgError, "max_steps must be at least 1");
+  }
+
+  clock->step = (int64_t)(step * 1e9);
+  clock->max_steps = max_steps;
+  clock->accumulator = 0;
+  clock->total_steps = 0;
+  clock->paused = 0;
+  clock->last_time = rb_glfw_clock_now();
+
+  return self;
+}
+
+
+
+/*
+ * Accumulates the time elapsed since the last tick (unless paused) and returns
+ * the number of fixed steps to simulate this frame.
+ *
+ * call-seq:
+ *    tick -> Integer
+ */
+static VALUE rb_glfw_clock_tick(VALUE self)
+{
+  rb_glfw_clock_t *clock = rb_get_clock(self);
+  int64_t now = rb_glfw_clock_now();
+  int64_t num_steps = 0;
+
+  /* Ignore time going backwards, e.g. after Glfw.time= */
+  if (!clock->paused && now > clock->last_time) {
+    clock->accumulator += now - clock->last_time;
+  }
+  clock->last_time = now;
+
+  num_steps = clock->accumulator / clock->step;
+  if (num_steps > clock->max_steps) {
+    num_steps = clock->max_steps;
+    clock->accumulator %= clock->step;
+  } else {
+    clock->accumulator -= num_steps * clock->step;
+  }
+  clock->total_steps += (long)num_steps;
+
+  return LONG2FIX((long)num_steps);
+}
+
+
+
+/*
+ * The fraction of a step left in the accumulator after the last #tick, in the
+ * range [0, 1). Use it to interpolate rendering between the previous and
+ * current simulation states.
+ *
+ * call-seq:
+ *    alpha -> Float
+ */
+static VALUE rb_glfw_clock_alpha(VALUE self)
+{
+  rb_glfw_clock_t *clock = rb_get_clock(self);
+  return rb_float_new((double)clock->accumulator / (double)clock->step);
+}
+
+
+
+/*
+ * The length of a step in seconds.
+ *
+ * call-seq:
+ *    step -> Float
+ */
+static VALUE rb_glfw_clock_step(VALUE self)
+{
+  return rb_float_new((double)rb_get_clock(self)->step * 1e-9);
+}
+
+
+
+/*
+ * The total number of steps returned by #tick since the clock was created or
+ * last #reset.
+ *
+ * call-seq:
+ *    total_steps -> Integer
+ */
+static VALUE rb_glfw_clock_total_steps(VALUE self)
+{
+  return LONG2NUM(rb_get_clock(self)->total_steps);
+}
+
+
+
+/*
+ * Pauses the clock. While paused, elapsed time isn't accumulated, so #tick
+ * returns 0 until the clock is resumed.
+ *
+ * call-seq:
+ *    pause -> self
+ */
+static VALUE rb_glfw_clock_pause(VALUE self)
+{
+  rb_get_clock(self)->paused = 1;
+  return self;
+}
+
+
+
+/*
+ * Resumes a paused clock. Time spent paused is not counted.
+ *
+ * call-seq:
+ *    resume -> self
+ */
+static VALUE rb_glfw_clock_resume(VALUE self)
+{
+  rb_glfw_clock_t *clock = rb_get_clock(self);
+  if (clock->paused) {
+    clock->paused = 0;
+    clock->last_time = rb_glfw_clock_now();
+  }
+  return self;
+}
+
+
+
+/*
+ * Returns whether the clock is paused.
+ *
+ * call-seq:
+ *    paused? -> true or false
+ */
+static VALUE rb_glfw_clock_paused(VALUE self)
+{
+  return rb_get_clock(self)->paused ? Qtrue : Qfalse;
+}
+
+
+
+/*
+ * Empties the accumulator and step count and restarts timing from now.
+ *
+ * call-seq:
+ *    reset -> self
+ */
+static VALUE rb_glfw_clock_reset(VALUE self)
+{
+  rb_glfw_clock_t *clock = rb_get_clock(self);
+  clock->accumulator = 0;
+  clock->total_steps = 0;
+  clock->last_time = rb_glfw_clock_now();
+  return self;
+}
+
+
+
+/* Makes the window's context current, recording a trace span if tracing. */
+static void rb_window_make_current(GLFWwindow *window)
+{
+  int64_t begin;
+
+  /*
+   * GLFW tracks each thread's current context, so checking it is cheap and
+   * skips the (often expensive) switch when it would do nothing.
+   */
+  if (glfwGetCurrentContext() == window) {
+    return;
+  }
+
+  if (!s_trace_enabled) {
+    glfwMakeContextCurrent(window);
+    return;
+  }
+
+  begin = rb_glfw_time_ns();
+  glfwMakeContextCurrent(window);
+  rb_trace_record(kTRACE_MAKE_CONTEXT_CURRENT, 0, window, begin, rb_glfw_time_ns());
+}
+
+/*
+ * Makes the window's GL context current. You will need to call this before
+ * calling any OpenGL functions. See also ::unset_context to unset a context.
+ *
+ * Wraps glfwMakeContextCurrent(window).
+ *
+ *    # Good
+ *    window.make_context_current()
+ *    Gl.glClear(Gl::GL_COLOR_BUFFER_BIT)
+ *
+ *    # Bad
+ *    Gl.glClear(Gl::GL_COLOR_BUFFER_BIT)
+ *    window.make_context_current()
+ *
+ * Remember to make a window's context current before calling any OpenGL
+ * functions. A window's GL context may only be current in one thread at a time.
+ *
+ * Does nothing if the context is already current on the calling thread.
+ */
+static VALUE rb_window_make_context_current(VALUE self)
+{
+  rb_window_make_current(rb_get_window(self));
+  return self;
+}
 
-static void rb_window_cursor_position_callback(GLFWwindow *window, double x, double y)
+
+
+/*
+ * Unsets the current GL context.
+ *
+ * Wraps glfwMakeContextCurrent(NULL).
+ */
+static VALUE rb_window_unset_context(VALUE self)
+{
+  rb_window_make_current(NULL);
+  return self;
+}
+
+
+
+/*
+ * Gets the window for the current GL context in this thread.
+ *
+ * call-seq:
+ *    current_context() -> Glfw::Window
+ *
+ * Wraps glfwGetCurrentContext.
+ */
+static VALUE rb_window_get_current_context(VALUE self)
+{
+  return rb_lookup_window(glfwGetCurrentContext());
+}
+
+
+
+static void *rb_window_swap_buffers_nogvl(void *window)
+{
+  glfwSwapBuffers((GLFWwindow *)window);
+  return NULL;
+}
+
+/*
+ * How long before a pacing deadline to stop sleeping and start spinning on
+ * glfwGetTime. Needs to cover the OS's usual sleep overshoot.
+ */
+static const double kPACE_SPIN_SECONDS = 0.0015;
+
+/* Longest single sleep while pacing, so interrupts are noticed promptly. */
+static const double kPACE_MAX_SLEEP_SECONDS = 0.01;
+
+typedef struct rb_glfw_pace {
+  double deadline;
+  volatile int interrupted;
+} rb_glfw_pace_t;
+
+static void *rb_glfw_pace_nogvl(void *data)
+{
+  rb_glfw_pace_t *pace = (rb_glfw_pace_t *)data;
+  double remaining = 0.0;
+
+  /* Sleep through most of the wait... */
+  while (!pace->interrupted &&
+         (remaining = pace->deadline - glfwGetTime() - kPACE_SPIN_SECONDS) > 0.0) {
+    struct timespec interval;
+    if (remaining > kPACE_MAX_SLEEP_SECONDS) {
+      remaining = kPACE_MAX_SLEEP_SECONDS;
+    }
+    interval.tv_sec = (time_t)remaining;
+    interval.tv_nsec = (long)((remaining - (double)interval.tv_sec) * 1e9);
+    nanosleep(&interval, NULL);
+  }
+
+  /* ...then spin for the rest to hit the deadline precisely. */
+  while (!pace->interrupted && glfwGetTime() < pace->deadline) {
+    ;
+  }
+
+  return NULL;
+}
+
+static void rb_glfw_pace_ubf(void *data)
+{
+  ((rb_glfw_pace_t *)data)->interrupted = 1;
+}
+
+/*
+ * Advances a pacing deadline by one period and waits until it passes, without
+ * holding the GVL. If the deadline has already passed (e.g., the frame ran
+ * long), it's reset to now rather than trying to catch up.
+ */
+static void rb_glfw_pace(double *deadline, double period)
+{
+  rb_glfw_pace_t pace;
+  double now = glfwGetTime();
+
+  *deadline += period;
+  if (*deadline <= now) {
+    *deadline = now;
+    return;
+  }
+
+  pace.deadline = *deadline;
+  pace.interrupted = 0;
+  rb_glfw_call_without_gvl(rb_glfw_pace_nogvl, &pace, rb_glfw_pace_ubf, &pace);
+  if (pace.interrupted) {
+    rb_thread_check_ints();
+  }
+}
+
+/* Longest #swap_buffers waits for events for a paused window */
+static const double kTHROTTLE_PAUSED_HZ = 10.0;
+
+/*
+ * Waits up to seconds with the GVL released for a throttled window's next
+ * frame. Events and Glfw::post_to_main cut the wait short, so input and posted
+ * work aren't held up. Doesn't process any events.
+ */
+static void rb_window_throttle_wait(double seconds)
+{
+  if (seconds <= 0.0) {
+    return;
+  }
+  if (!rb_glfw_wait_for_events(seconds < INT_MAX / 1000 ? (int)(seconds * 1000.0 + 0.999) : INT_MAX)) {
+    rb_glfw_nap(seconds);
+  }
+}
+
+/* Returns whether the window's throttle policy currently pauses it. */
+static int rb_window_paused(const rb_glfw_window_t *state)
+{
+  return state->pause_when_hidden && (state->iconified || !state->visible);
+}
+
+/* Returns the rate the window's frames are currently capped to, or 0. */
+static double rb_window_rate_cap(const rb_glfw_window_t *state)
+{
+  return (state->unfocused_hz > 0.0 && !state->focused) ? state->unfocused_hz : 0.0;
+}
+
+/*
+ * Lowers *next_due to when the window is next due a frame, if that's known:
+ * when its throttle period ends if it's capped, or now if it's dirty in
+ * on-demand mode. Uncapped windows that redraw every frame don't count, since
+ * they'd never let an adaptive loop wait, and nor do paused ones.
+ */
+static void rb_window_fold_wake_time(const rb_glfw_window_t *state, double now, double *next_due)
+{
+  double cap = 0.0;
+  double due = now;
+
+  if (state->handle == NULL || rb_window_paused(state) ||
+      (state->render_on_demand && !state->dirty)) {
+    return;
+  }
+
+  cap = rb_window_rate_cap(state);
+  if (cap > 0.0) {
+    due = state->throttle_deadline + 1.0 / cap;
+  } else if (!state->render_on_demand) {
+    return;
+  }
+  if (*next_due < 0.0 || due < *next_due) {
+    *next_due = due;
+  }
+}
+
+static int rb_glfw_next_wake_time_i(VALUE key, VALUE rb_window, VALUE arg)
+{
+  VALUE rb_window_data = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_INTERNAL);
+  rb_glfw_window_t *state = NULL;
+  if (RTEST(rb_window_data)) {
+    Data_Get_Struct(rb_window_data, rb_glfw_window_t, state);
+    rb_window_fold_wake_time(state, glfwGetTime(), (double *)arg);
+  }
+  return ST_CONTINUE;
+}
+
+/* Returns when any open window is next due a frame, or -1 if none is known. */
+static double rb_glfw_next_wake_time(void)
+{
+  double next_due = -1.0;
+  rb_hash_foreach(rb_cvar_get(s_glfw_window_klass, kRB_CVAR_WINDOW_WINDOWS),
+                  rb_glfw_next_wake_time_i, (VALUE)&next_due);
+  return next_due;
+}
+
+/*
+ * Returns whether the window's throttle policy and on-demand mode allow it a
+ * frame at time now, and if so, starts the frame's throttle period. If it's
+ * capped and not due yet, *next_due is lowered to when it will be.
+ */
+static int rb_window_frame_due(rb_glfw_window_t *state, double now, double *next_due)
+{
+  double cap = 0.0;
+  double due = 0.0;
+
+  if (rb_window_paused(state) || (state->render_on_demand && !state->dirty)) {
+    return 0;
+  }
+
+  cap = rb_window_rate_cap(state);
+  if (cap > 0.0) {
+    due = state->throttle_deadline + 1.0 / cap;
+    if (now < due) {
+      if (*next_due < 0.0 || due < *next_due) {
+        *next_due = due;
+      }
+      return 0;
+    }
+    state->throttle_deadline = now;
+  }
+  return 1;
+}
+
+/* Flushes deferred writes and swaps the window's buffers without the GVL. */
+static void rb_window_swap(rb_glfw_window_t *state)
+{
+  int timed = s_frame_stats_enabled || s_trace_enabled || state->input_pending_since;
+  int64_t swap_begin = 0;
+  int64_t swap_end = 0;
+
+  if (state->pending_writes) {
+    rb_window_apply_writes(state);
+  }
+
+  if (timed) {
+    swap_begin = rb_glfw_time_ns();
+  }
+
+  rb_glfw_call_without_gvl(rb_window_swap_buffers_nogvl, state->handle, NULL, NULL);
+
+  if (timed) {
+    swap_end = rb_glfw_time_ns();
+    if (s_frame_stats_enabled) {
+      rb_window_record_frame(state, swap_begin, swap_end);
+    }
+    if (state->input_pending_since) {
+      rb_window_input_presented(state, swap_end);
+    }
+    if (s_trace_enabled) {
+      rb_trace_record(kTRACE_SWAP_BUFFERS, 0, state->handle, swap_begin, swap_end);
+    }
+  }
+}
+
+/*
+ * Swaps the front and back buffers for the window. You will typically call this
+ * at the end of your drawing routines. Other Ruby threads may run while this
+ * waits on the swap (e.g., for vsync).
+ *
+ * This honours the window's throttle policy: while it's paused (see
+ * #pause_when_hidden=), this doesn't swap and instead waits up to a tenth of a
+ * second, and while its frame rate is capped (see #unfocused_hz=), this waits
+ * out the rest of the frame after swapping. Either wait releases the GVL and
+ * ends early when events arrive or Glfw::post_to_main is called. If called
+ * again before the frame is up, this waits out the rest without swapping.
+ *
+ * Swapping clears the window's dirty flag (see #needs_redraw?). In on-demand
+ * mode (see #render_on_demand=), this doesn't swap unless the flag is set.
+ *
+ * Wraps glfwSwapBuffers.
+ *
+ *    loop {
+ *      Glfw.poll_events()
+ *
+ *      # ...
+ *
+ *      window.swap_buffers()
+ *    }
+ */
+static VALUE rb_window_swap_buffers(VALUE self)
+{
+  rb_glfw_window_t *state = rb_require_window_state(self);
+  double cap = 0.0;
+  double due = 0.0;
+
+  if (rb_window_paused(state)) {
+    rb_window_throttle_wait(1.0 / kTHROTTLE_PAUSED_HZ);
+    return self;
+  }
+
+  if (state->render_on_demand && !state->dirty) {
+    return self;
+  }
+
+  /* Finish a frame whose wait an event cut short rather than swap early */
+  cap = rb_window_rate_cap(state);
+  if (cap > 0.0) {
+    due = state->throttle_deadline + 1.0 / cap;
+    if (glfwGetTime() < due) {
+      rb_window_throttle_wait(due - glfwGetTime());
+      return self;
+    }
+  }
+
+  rb_window_swap(state);
+  state->dirty = 0;
+
+  if (cap > 0.0) {
+    state->throttle_deadline = glfwGetTime();
+    rb_window_throttle_wait(1.0 / cap);
+  }
+  return self;
+}
+
+
+
+/*
+ * Returns whether the window is due a frame now: false while its throttle
+ * policy pauses it (see #pause_when_hidden=), until its capped frame period
+ * has passed (see #unfocused_hz=), and, in on-demand mode (see
+ * #render_on_demand=), until it's dirty. #swap_buffers doesn't swap while this
+ * is false, so a loop driving its own frames can skip drawing them, e.g., when
+ * an event cut its wait short.
+ *
+ * call-seq:
+ *    frame_due? -> true or false
+ *
+ * For example:
+ *
+ *    loop {
+ *      Glfw.pump_events
+ *      next unless window.frame_due?
+ *      # Draw
+ *      window.swap_buffers
+ *    }
+ */
+static VALUE rb_window_is_frame_due(VALUE self)
+{
+  rb_glfw_window_t *state = rb_require_window_state(self);
+  double cap = 0.0;
+
+  if (rb_window_paused(state) || (state->render_on_demand && !state->dirty)) {
+    return Qfalse;
+  }
+  cap = rb_window_rate_cap(state);
+  return (cap <= 0.0 || glfwGetTime() >= state->throttle_deadline + 1.0 / cap) ? Qtrue : Qfalse;
+}
+
+
+
+typedef struct rb_glfw_swap_batch {
+  GLFWwindow **windows;
+  long count;
+  /* Context to leave current afterward */
+  GLFWwindow *restore;
+} rb_glfw_swap_batch_t;
+
+/* Numbers swap_all calls, so a window listed twice is only swapped once */
+static unsigned long s_swap_all_serial = 0;
+
+static void *rb_window_swap_all_nogvl(void *data)
+{
+  rb_glfw_swap_batch_t *batch = (rb_glfw_swap_batch_t *)data;
+  long index = 0;
+  for (; index < batch->count; ++index) {
+    GLFWwindow *window = batch->windows[index];
+    if (glfwGetCurrentContext() != window) {
+      glfwMakeContextCurrent(window);
+    }
+    glfwSwapBuffers(window);
+  }
+  if (glfwGetCurrentContext() != batch->restore) {
+    glfwMakeContextCurrent(batch->restore);
+  }
+  return NULL;
+}
+
+/*
+ * Swaps the buffers of each of the given windows, releasing the GVL once for
+ * all of them rather than once per window. Destroyed windows are skipped, and
+ * so are windows whose throttle policy or on-demand mode (see
+ * #pause_when_hidden=, #unfocused_hz=, and #render_on_demand=) means they
+ * aren't due a frame, the same way as in Glfw::run. A window listed more
+ * than once is swapped once. Returns the number of windows swapped.
+ *
+ * Each window's context is made current for its swap, since some backends
+ * (e.g., EGL) require it. The window whose context is current on this thread,
+ * if any, is swapped last, so switching back to it is the last switch and its
+ * pending GL commands have longest to run. Whichever context was current
+ * before is current again afterward.
+ *
+ * call-seq:
+ *    swap_all(windows) -> Integer
+ */
+static VALUE rb_window_swap_all(VALUE self, VALUE rb_windows)
+{
+  GLFWwindow *current = glfwGetCurrentContext();
+  rb_glfw_swap_batch_t batch;
+  VALUE rb_buffer = 0;
+  double now = glfwGetTime();
+  double next_due = -1.0;
+  int current_due = 0;
+  int timed = s_frame_stats_enabled || s_trace_enabled;
+  unsigned long serial = 0;
+  long swapped = 0;
+  long count = 0;
+  long index = 0;
+
+  Check_Type(rb_windows, T_ARRAY);
+  /*
+   * Instrumented swaps release the GVL, so another thread may resize the
+   * array during the loop. Only the windows it held on entry are considered,
+   * which is all batch.windows has room for.
+   */
+  count = RARRAY_LEN(rb_windows);
+  batch.windows = ALLOCV_N(GLFWwindow *, rb_buffer, count + 1);
+  batch.count = 0;
+  batch.restore = current;
+  serial = ++s_swap_all_serial;
+
+  for (; index < count && index < RARRAY_LEN(rb_windows); ++index) {
+    rb_glfw_window_t *state = rb_get_window_state(rb_ary_entry(rb_windows, index));
+    if (state == NULL || state->handle == NULL || state->swap_all_serial == serial ||
+        !rb_window_frame_due(state, now, &next_due)) {
+      continue;
+    }
+
+    ++swapped;
+    state->swap_all_serial = serial;
+    state->dirty = 0;
+    if (timed || state->input_pending_since) {
+      /* Instrumented swaps record timings, so go one at a time */
+      rb_window_make_current(state->handle);
+      rb_window_swap(state);
+    } else if (state->handle == current) {
+      if (state->pending_writes) {
+        rb_window_apply_writes(state);
+      }
+      current_due = 1;
+    } else {
+      if (state->pending_writes) {
+        rb_window_apply_writes(state);
+      }
+      batch.windows[batch.count++] = state->handle;
+    }
+  }
+
+  if (current_due) {
+    batch.windows[batch.count++] = current;
+  }
+  if (batch.count > 0) {
+    rb_glfw_call_without_gvl(rb_window_swap_all_nogvl, &batch, NULL, NULL);
+  } else {
+    rb_window_make_current(current);
+  }
+  ALLOCV_END(rb_buffer);
+
+  return LONG2NUM(swapped);
+}
+
+
+
+/*
+ * Waits until 1 / target_hz seconds have passed since the window's previous
+ * call to #pace, for limiting the frame rate without vsync. Most of the wait
+ * is spent sleeping with the GVL released, and the last moment is spent
+ * spinning on the GLFW timer, so the deadline is hit closely without burning a
+ * core.
+ *
+ * If a frame runs past its deadline, the next frame is paced from the time of
+ * the late call rather than rushing to catch up.
+ *
+ * call-seq:
+ *    pace(target_hz) -> self
+ *
+ * For example:
+ *
+ *    loop {
+ *      Glfw.poll_events
+ *      # Draw
+ *      window.swap_buffers
+ *      window.pace(120)
+ *    }
+ */
+static VALUE rb_window_pace(VALUE self, VALUE target_hz)
+{
+  rb_glfw_window_t *state = rb_require_window_state(self);
+  double hz = NUM2DBL(target_hz);
+  if (hz <= 0.0) {
+    rb_raise(rb_eArgError, "target_hz must be greater than zero");
+  }
+  rb_glfw_pace(&state->pace_deadline, 1.0 / hz);
+  return self;
+}
+
+
+/*
+ * Sets whether the window pauses while it's iconified or hidden: #frame_due?
+ * is false, #swap_buffers stops swapping and instead waits for events for up
+ * to a tenth of a second, and Glfw::run stops yielding the window (and waits
+ * for events once every window it's running is paused). Off by default.
+ *
+ * call-seq:
+ *    pause_when_hidden = pause -> pause
+ */
+static VALUE rb_window_set_pause_when_hidden(VALUE self, VALUE pause)
+{
+  rb_require_window_state(self)->pause_when_hidden = RTEST(pause);
+  return pause;
+}
+
+
+
+/*
+ * Returns whether the window pauses while iconified or hidden. See
+ * #pause_when_hidden=.
+ *
+ * call-seq:
+ *    pause_when_hidden? -> true or false
+ */
+static VALUE rb_window_get_pause_when_hidden(VALUE self)
+{
+  return rb_require_window_state(self)->pause_when_hidden ? Qtrue : Qfalse;
+}
+
+
+
+/*
+ * Caps the window's frame rate while it doesn't have input focus, or removes
+ * the cap if nil: #swap_buffers waits out the rest of each 1 / hz second frame
+ * after swapping (ending early for events), #frame_due? is only true once per
+ * frame, and Glfw::run only yields the window once per frame.
+ *
+ * call-seq:
+ *    unfocused_hz = hz -> hz
+ */
+static VALUE rb_window_set_unfocused_hz(VALUE self, VALUE rb_hz)
+{
+  rb_glfw_window_t *state = rb_require_window_state(self);
+  double hz = 0.0;
+
+  if (!NIL_P(rb_hz)) {
+    hz = NUM2DBL(rb_hz);
+    if (hz <= 0.0) {
+      rb_raise(rb_eArgError, "unfocused_hz must be greater than zero");
+    }
+  }
+  state->unfocused_hz = hz;
+  return rb_hz;
+}
+
+
+
+/*
+ * Returns the window's frame rate cap while unfocused, or nil if it has none.
+ * See #unfocused_hz=.
+ *
+ * call-seq:
+ *    unfocused_hz -> Float or nil
+ */
+static VALUE rb_window_get_unfocused_hz(VALUE self)
+{
+  rb_glfw_window_t *state = rb_require_window_state(self);
+  return state->unfocused_hz > 0.0 ? rb_float_new(state->unfocused_hz) : Qnil;
+}
+
+
+
+/*
+ * Returns whether the window's throttle policy currently applies, i.e.,
+ * whether it's paused or has its frame rate capped.
+ *
+ * call-seq:
+ *    throttled? -> true or false
+ */
+static VALUE rb_window_is_throttled(VALUE self)
 {
-  VALUE rb_window = rb_lookup_window(window);
-  if (RTEST(rb_window)) {
-    VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_CURSOR_POSITION_CALLBACK);
-    if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
-      rb_funcall(rb_func, kRB_CALL, 3, rb_window, rb_float_new(x), rb_float_new(y));
-    }
-  }
+  rb_glfw_window_t *state = rb_require_window_state(self);
+  return (rb_window_paused(state) || rb_window_rate_cap(state) > 0.0) ? Qtrue : Qfalse;
 }
 
-RB_ENABLE_CALLBACK_DEF(rb_window_set_cursor_position_callback, rb_window_cursor_position_callback, glfwSetCursorPosCallback);
-
 
 
-static void rb_window_cursor_enter_callback(GLFWwindow *window, int entered)
+/*
+ * Returns whether the window is dirty: whether something has changed since
+ * its last frame was presented. The binding marks a window dirty when it's
+ * created, shown, restored, refreshed, resized, or gains or loses focus, and
+ * Ruby code can mark it with #mark_dirty. #swap_buffers clears the flag, as
+ * does Glfw::run just before yielding the window.
+ *
+ * call-seq:
+ *    needs_redraw? -> true or false
+ */
+static VALUE rb_window_needs_redraw(VALUE self)
 {
-  VALUE rb_window = rb_lookup_window(window);
-  if (RTEST(rb_window)) {
-    VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_CURSOR_ENTER_CALLBACK);
-    if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
-      rb_funcall(rb_func, kRB_CALL, 2, rb_window, entered ? Qtrue : Qfalse);
-    }
-  }
+  return rb_require_window_state(self)->dirty ? Qtrue : Qfalse;
 }
 
-RB_ENABLE_CALLBACK_DEF(rb_window_set_cursor_enter_callback, rb_window_cursor_enter_callback, glfwSetCursorEnterCallback);
-
 
 
-static void rb_window_scroll_callback(GLFWwindow *window, double x, double y)
+/*
+ * Marks the window dirty, so it's redrawn in on-demand mode. See
+ * #needs_redraw?. Can be called from any thread: if the window wasn't already
+ * dirty, a main thread waiting for events (e.g., in Glfw::run or
+ * Glfw::pump_events) wakes to draw it.
+ *
+ * call-seq:
+ *    mark_dirty -> self
+ */
+static VALUE rb_window_mark_dirty(VALUE self)
 {
-  VALUE rb_window = rb_lookup_window(window);
-  if (RTEST(rb_window)) {
-    VALUE rb_func = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_SCROLL_CALLBACK);
-    if (rb_obj_respond_to(rb_func, kRB_CALL, 0)) {
-      rb_funcall(rb_func, kRB_CALL, 3, rb_window, rb_float_new(x), rb_float_new(y));
-    }
+  rb_glfw_window_t *state = rb_require_window_state(self);
+  if (!state->dirty) {
+    state->dirty = 1;
+    rb_glfw_wakeup();
   }
+  return self;
 }
 
-RB_ENABLE_CALLBACK_DEF(rb_window_set_scroll_callback, rb_window_scroll_callback, glfwSetScrollCallback);
-
-
 
 
 /*
- * Returns whether the given joystick is present.
+ * Sets whether the window renders on demand, i.e., only when it's dirty (see
+ * #needs_redraw?). In on-demand mode, #swap_buffers does nothing for a clean
+ * window and Glfw::run doesn't yield it. Off by default.
  *
- * call-seq:
- *    joystick_present?(joystick) -> true or false
+ * For example:
  *
- * Wraps glfwJoystickPresent.
+ *    window.render_on_demand = true
+ *    loop {
+ *      Glfw.wait_events
+ *      if window.needs_redraw?
+ *        # Draw
+ *        window.swap_buffers
+ *      end
+ *    }
+ *
+ * call-seq:
+ *    render_on_demand = on_demand -> on_demand
  */
-static VALUE rb_glfw_joystick_present(VALUE self, VALUE joystick)
+static VALUE rb_window_set_render_on_demand(VALUE self, VALUE on_demand)
 {
-  return glfwJoystickPresent(NUM2INT(joystick)) ? Qtrue : Qfalse;
+  rb_require_window_state(self)->render_on_demand = RTEST(on_demand);
+  return on_demand;
 }
 
 
 
 /*
- * Gets the values of all axes of the given joystick. Returns nil if the
- * joystick isn't present. See #joystick_present?.
+ * Returns whether the window renders on demand. See #render_on_demand=.
  *
  * call-seq:
- *    joystick_axes(joystick) -> [Float, ...] or nil
- *
- * Wraps glfwGetJoystickAxes.
+ *    render_on_demand? -> true or false
  */
-static VALUE rb_glfw_get_joystick_axes(VALUE self, VALUE joystick)
+static VALUE rb_window_get_render_on_demand(VALUE self)
 {
-  VALUE rb_axes = Qnil;
-  int num_axes = 0;
-  int axis_index = 0;
-  const float *axes = glfwGetJoystickAxes(NUM2INT(joystick), &num_axes);
-  if (num_axes > 0) {
-    rb_axes = rb_ary_new();
-    for (; axis_index < num_axes; ++axis_index) {
-      rb_ary_push(rb_axes, rb_float_new(axes[axis_index]));
-    }
-  }
-  return rb_axes;
+  return rb_require_window_state(self)->render_on_demand ? Qtrue : Qfalse;
 }
 
 
 
+
 /*
- * Gets the button values of the given joystick. Returns nil if the joystick
- * isn't present. See #joystick_present?.
+ * Runs a main loop for the given windows until all of them have their
+ * should-close flag set (see Glfw::Window#should_close=), or until the block
+ * breaks out of it.
+ *
+ * Each iteration polls for events (or waits for them, if poll is :wait, or
+ * does whichever ::pump_events would, if poll is :adaptive), then, for each
+ * window that isn't closing, makes its context current, yields the
+ * window and the time in seconds since the previous iteration, and swaps its
+ * buffers. Closing windows are skipped but not destroyed. If target_fps is
+ * given, each iteration is padded out to last at least 1 / target_fps seconds,
+ * the same way as Glfw::Window#pace.
+ *
+ * Windows' throttle policies are honoured (see
+ * Glfw::Window#pause_when_hidden= and Glfw::Window#unfocused_hz=): paused
+ * windows aren't yielded, capped ones are yielded once per frame of their
+ * capped rate, and when no window is due a frame the loop waits for events
+ * instead of polling. Windows in on-demand mode (see
+ * Glfw::Window#render_on_demand=) are only yielded while dirty, so a loop of
+ * them sleeps until something changes. With poll :adaptive, an idle loop
+ * waits for events until the next capped or dirty window is due a frame
+ * rather than indefinitely. The delta yielded is the time since the window's
+ * previous frame.
  *
  * call-seq:
- *    joystick_buttons(joystick) -> [Fixed, ...] or nil
+ *    run(windows, poll: :poll, target_fps: nil) { |window, delta| ... } -> self
  *
- * Wraps glfwGetJoystickButtons.
+ * For example:
+ *
+ *    Glfw.run([window], target_fps: 60) { |window, delta|
+ *      # Update and draw
+ *    }
  */
-static VALUE rb_glfw_get_joystick_buttons(VALUE self, VALUE joystick)
+static VALUE rb_glfw_run(int argc, VALUE *argv, VALUE self)
 {
-  VALUE rb_buttons = Qnil;
-  int num_buttons = 0;
-  int button_index = 0;
-  const unsigned char *buttons = glfwGetJoystickButtons(NUM2INT(joystick), &num_buttons);
-  if (num_buttons > 0) {
-    rb_buttons = rb_ary_new();
-    for (; button_index < num_buttons; ++button_index) {
-      rb_ary_push(rb_buttons, rb_float_new(INT2FIX((int)buttons[button_index])));
+  VALUE rb_windows, rb_options;
+  ID kwarg_ids[2];
+  VALUE kwargs[2];
+  int wait = 0;
+  int adaptive = 0;
+  double period = 0.0;
+  double frame_time, next_frame;
+  /* How long to wait for events when no window is due a frame, or when idle
+     with adaptive pumping */
+  double throttle_wait = 0.0;
+  double next_due;
+  long window_index;
+  long num_open;
+  long num_drawn;
+
+  rb_need_block();
+  rb_scan_args(argc, argv, "1:", &rb_windows, &rb_options);
+  Check_Type(rb_windows, T_ARRAY);
+
+  kwarg_ids[0] = kRB_POLL;
+  kwarg_ids[1] = kRB_TARGET_FPS;
+  kwargs[0] = kwargs[1] = Qundef;
+  if (!NIL_P(rb_options)) {
+    rb_get_kwargs(rb_options, kwarg_ids, 0, 2, kwargs);
+  }
+
+  if (kwargs[0] != Qundef && !NIL_P(kwargs[0])) {
+    if (kwargs[0] == ID2SYM(kRB_WAIT)) {
+      wait = 1;
+    } else if (kwargs[0] == ID2SYM(kRB_ADAPTIVE)) {
+      adaptive = 1;
+    } else if (kwargs[0] != ID2SYM(kRB_POLL)) {
+      rb_raise(rb_eArgError, "poll must be :poll, :wait, or :adaptive");
     }
   }
-  return rb_buttons;
+
+  if (kwargs[1] != Qundef && !NIL_P(kwargs[1])) {
+    double target_fps = NUM2DBL(kwargs[1]);
+    if (target_fps <= 0.0) {
+      rb_raise(rb_eArgError, "target_fps must be greater than zero");
+    }
+    period = 1.0 / target_fps;
+  }
+
+  next_frame = glfwGetTime();
+  for (window_index = 0; window_index < RARRAY_LEN(rb_windows); ++window_index) {
+    rb_glfw_window_t *state = rb_get_window_state(rb_ary_entry(rb_windows, window_index));
+    if (state) {
+      state->last_frame_time = next_frame;
+    }
+  }
+
+  for (;;) {
+    if (adaptive) {
+      rb_glfw_pump_adaptive(throttle_wait);
+    } else {
+      rb_glfw_pump_events(wait ? -1.0 : throttle_wait);
+    }
+
+    frame_time = glfwGetTime();
+    num_open = 0;
+    num_drawn = 0;
+    next_due = -1.0;
+
+    for (window_index = 0; window_index < RARRAY_LEN(rb_windows); ++window_index) {
+      VALUE rb_window = rb_ary_entry(rb_windows, window_index);
+      VALUE rb_window_data = Qnil;
+      rb_glfw_window_t *state = NULL;
+
+      if (!Q_IS_A(rb_window, s_glfw_window_klass) ||
+          !RTEST((rb_window_data = rb_ivar_get(rb_window, kRB_IVAR_WINDOW_INTERNAL)))) {
+        continue;
+      }
+
+      Data_Get_Struct(rb_window_data, rb_glfw_window_t, state);
+      if (state->handle == NULL || glfwWindowShouldClose(state->handle)) {
+        continue;
+      }
+
+      ++num_open;
+      if (!rb_window_frame_due(state, frame_time, &next_due)) {
+        continue;
+      }
+
+      ++num_drawn;
+      /* Cleared first, so the block can mark the window dirty again */
+      state->dirty = 0;
+      rb_window_make_current(state->handle);
+      rb_yield_values(2, rb_window, rb_float_new(frame_time - state->last_frame_time));
+      state->last_frame_time = frame_time;
+
+      /* The block may have destroyed the window, so keep its state alive and
+         check before swapping */
+      if (state->handle != NULL) {
+        rb_window_swap(state);
+        rb_window_fold_wake_time(state, frame_time, &next_due);
+      }
+      /* Don't wait for events on behalf of a window the block just closed */
+      if (state->handle == NULL || glfwWindowShouldClose(state->handle)) {
+        --num_open;
+      }
+      RB_GC_GUARD(rb_window_data);
+    }
+
+    if (num_open == 0) {
+      break;
+    }
+
+    /* Wait for the next capped window's frame, or for events if none is due.
+       Adaptive pumping waits the same way whenever it's idle. */
+    throttle_wait = 0.0;
+    if (num_drawn == 0 || adaptive) {
+      throttle_wait = rb_glfw_wait_until(next_due);
+    }
+
+    if (period > 0.0) {
+      rb_glfw_pace(&next_frame, period);
+    }
+  }
+
+  return self;
 }
 
 
 
 /*
- * Returns the name of the given joystick.
+ * Sets the swap interval for the current context.
+ * (See Glfw::Window#make_context_current)
  *
  * call-seq:
- *    joystick_name(joystick) -> String
+ *    swap_interval=(interval) -> self
+ *    swap_interval = interval -> self
  *
- * Wraps glfwGetJoystickName.
+ * Wraps glfwSwapInterval.
  */
-static VALUE rb_glfw_get_joystick_name(VALUE self, VALUE joystick)
+static VALUE rb_glfw_swap_interval(VALUE self, VALUE interval)
 {
-  const char *joy_name = glfwGetJoystickName(NUM2INT(joystick));
-  if (joy_name) {
-    return rb_str_new2(joy_name);
-  } else {
-    return Qnil;
-  }
+  glfwSwapInterval(NUM2INT(interval));
+  return self;
 }
 
 
 
 /*
- * Sets the system clipboard string. The window this is set for will own the
- * given string.
+ * Retursn whether a given OpenGL or context creation API extension is supported
+ * by the current context.
+ * (See Glfw::Window#make_context_current)
+ *
+ * Bear in mind that this function does not cache its results, so calls may be
+ * expensive. If you find yourself using it, consider caching the results
+ * yourself.
  *
  * call-seq:
- *    clipboard_string=(string) -> String
- *    clipboard_string = string -> String
+ *    extension_supported?(extension) -> true or false
  *
- * Wraps glfwSetClipboardString.
+ * Wraps glfwExtensionSupported.
  */
-static VALUE rb_window_set_clipboard_string(VALUE self, VALUE string)
+static VALUE rb_glfw_extension_supported(VALUE self, VALUE extension)
 {
-  glfwSetClipboardString(rb_get_window(self), StringValueCStr(string));
-  return string;
+  return glfwExtensionSupported(StringValueCStr(extension)) ? Qtrue : Qfalse;
 }
 
 
 
+#ifdef GLFW_STUB
+
 /*
- * Gets the system clipboard's contents as a string. The window this is called
- * from will request the clipboard contents.
+ * Glfw::Stub drives the headless stub backend. It's only defined when the
+ * extension is built with --enable-stub.
+ */
+static VALUE s_glfw_stub_module = Qundef;
+
+/* Maps callback event types (see kCALLBACK_NAMES) to stub event types */
+static const int kSTUB_EVENT_TYPES[kCALLBACK_COUNT] = {
+  -1, -1,
+  GLFW_STUB_EVENT_KEY,
+  GLFW_STUB_EVENT_CHAR,
+  GLFW_STUB_EVENT_MOUSE_BUTTON,
+  GLFW_STUB_EVENT_CURSOR_POS,
+  GLFW_STUB_EVENT_CURSOR_ENTER,
+  GLFW_STUB_EVENT_SCROLL,
+  GLFW_STUB_EVENT_WINDOW_POS,
+  GLFW_STUB_EVENT_WINDOW_SIZE,
+  GLFW_STUB_EVENT_WINDOW_CLOSE,
+  GLFW_STUB_EVENT_WINDOW_REFRESH,
+  GLFW_STUB_EVENT_WINDOW_FOCUS,
+  GLFW_STUB_EVENT_WINDOW_ICONIFY,
+  GLFW_STUB_EVENT_FRAMEBUFFER_SIZE
+};
+
+/* Number of arguments each stub event type takes after the window */
+static const int kSTUB_EVENT_ARITY[kCALLBACK_COUNT] = {
+  0, 0, 4, 1, 3, 2, 1, 2, 2, 2, 0, 0, 1, 1, 2
+};
+
+/*
+ * Queues an event for the window, to be delivered through its callbacks by the
+ * next Glfw::poll_events or Glfw::wait_events. The event type and arguments
+ * are the same as the matching callback's, minus the window: :key (key,
+ * scancode, action, mods), :char (codepoint), :mouse_button (button, action,
+ * mods), :cursor_position (x, y), :cursor_enter (entered), :scroll (x, y),
+ * :position (x, y), :size (width, height), :close, :refresh, :focus (focused),
+ * :iconify (iconified), and :framebuffer_size (width, height).
  *
- * call-seq:
- *    clipboard_string() -> String
+ * A :size event also resizes the framebuffer, and a :close event sets the
+ * window's should-close flag, as they would on a real windowing system.
  *
- * Wraps glfwGetClipboardString.
+ * call-seq:
+ *    post_event(window, type, *args) -> self
  */
-static VALUE rb_window_get_clipboard_string(VALUE self)
+static VALUE rb_stub_post_event(int argc, VALUE *argv, VALUE self)
 {
-  return rb_str_new2(glfwGetClipboardString(rb_get_window(self)));
+  GLFWstubevent event;
+  VALUE rb_window, rb_type, rb_args;
+  int callback = 0;
+  int arg_index = 0;
+
+  rb_scan_args(argc, argv, "2*", &rb_window, &rb_type, &rb_args);
+  Check_Type(rb_type, T_SYMBOL);
+
+  for (callback = kCALLBACK_KEY; callback < kCALLBACK_COUNT; ++callback) {
+    if (SYM2ID(rb_type) == rb_intern(kCALLBACK_NAMES[callback])) {
+      break;
+    }
+  }
+  if (callback == kCALLBACK_COUNT) {
+    rb_raise(rb_eArgError, "Unknown event type %s", rb_id2name(SYM2ID(rb_type)));
+  }
+  if (RARRAY_LEN(rb_args) != kSTUB_EVENT_ARITY[callback]) {
+    rb_raise(rb_eArgError, "%s events take %d arguments (%ld given)",
+      kCALLBACK_NAMES[callback], kSTUB_EVENT_ARITY[callback], RARRAY_LEN(rb_args));
+  }
+
+  MEMZERO(&event, GLFWstubevent, 1);
+  event.type = kSTUB_EVENT_TYPES[callback];
+  event.window = rb_get_window(rb_window);
+  for (; arg_index < kSTUB_EVENT_ARITY[callback]; ++arg_index) {
+    VALUE rb_arg = rb_ary_entry(rb_args, arg_index);
+    if (callback == kCALLBACK_CURSOR_POSITION || callback == kCALLBACK_SCROLL) {
+      event.d[arg_index] = NUM2DBL(rb_arg);
+    } else if (rb_arg == Qtrue || rb_arg == Qfalse) {
+      event.i[arg_index] = RTEST(rb_arg);
+    } else {
+      event.i[arg_index] = NUM2INT(rb_arg);
+    }
+  }
+
+  glfwStubPostEvent(&event);
+  return self;
 }
 
 
 
 /*
- * Gets the current time in seconds. The returned time is relative to the time
- * since GLFW was initialized unless the time has been set using #timer=.
+ * Returns the number of events queued with ::post_event (or by the stub
+ * itself, e.g. for Glfw::Window#set_position) that haven't been delivered yet.
  *
  * call-seq:
- *    time -> Float
- *
- * Wraps glfwGetTime.
+ *    pending_events -> Integer
  */
-static VALUE rb_glfw_get_time(VALUE self)
+static VALUE rb_stub_pending_events(VALUE self)
 {
-  return rb_float_new(glfwGetTime());
+  return INT2NUM(glfwStubPendingEvents());
 }
 
 
 
 /*
- * Sets the current time in seconds. If set, GLFW will continue measuring time
- * elapsed from that time forward.
+ * Sets how fast the stub's clock runs relative to real time. 0 freezes it,
+ * after which it only moves with ::advance_time. Defaults to 1.
  *
- * In most cases, you will not need to use this.
+ * A frozen clock never reaches a pacing deadline on its own, so
+ * Glfw::Window#pace and Glfw::run with a target_fps will wait until another
+ * thread advances it.
  *
  * call-seq:
- *    time = Float
- *
- * Wraps glfwSetTime.
+ *    clock_rate = rate -> rate
  */
-static VALUE rb_glfw_set_time(VALUE self, VALUE time_)
+static VALUE rb_stub_set_clock_rate(VALUE self, VALUE rb_rate)
 {
-  glfwSetTime(NUM2DBL(time_));
-  return time_;
+  glfwStubSetClockRate(NUM2DBL(rb_rate));
+  return rb_rate;
 }
 
 
 
 /*
- * Makes the window's GL context current. You will need to call this before
- * calling any OpenGL functions. See also ::unset_context to unset a context.
+ * Moves the stub's clock forward by the given number of seconds.
  *
- * Wraps glfwMakeContextCurrent(window).
- *
- *    # Good
- *    window.make_context_current()
- *    Gl.glClear(Gl::GL_COLOR_BUFFER_BIT)
- *
- *    # Bad
- *    Gl.glClear(Gl::GL_COLOR_BUFFER_BIT)
- *    window.make_context_current()
- *
- * Remember to make a window's context current before calling any OpenGL
- * functions. A window's GL context may only be current in one thread at a time.
+ * call-seq:
+ *    advance_time(seconds) -> self
  */
-static VALUE rb_window_make_context_current(VALUE self)
+static VALUE rb_stub_advance_time(VALUE self, VALUE rb_seconds)
 {
-  glfwMakeContextCurrent(rb_get_window(self));
+  glfwStubAdvanceTime(NUM2DBL(rb_seconds));
   return self;
 }
 
 
 
 /*
- * Unsets the current GL context.
+ * Connects a new monitor with a single video mode, calling the monitor
+ * callback. The stub starts with two monitors connected.
  *
- * Wraps glfwMakeContextCurrent(NULL).
+ * call-seq:
+ *    connect_monitor(name, width, height, refresh_rate = 60) -> Glfw::Monitor
  */
-static VALUE rb_window_unset_context(VALUE self)
+static VALUE rb_stub_connect_monitor(int argc, VALUE *argv, VALUE self)
 {
-  glfwMakeContextCurrent(NULL);
-  return self;
+  VALUE rb_name, rb_width, rb_height, rb_refresh_rate;
+  VALUE rb_monitor = Qnil;
+  GLFWmonitor *monitor = NULL;
+
+  rb_scan_args(argc, argv, "31", &rb_name, &rb_width, &rb_height, &rb_refresh_rate);
+
+  monitor = glfwStubConnectMonitor(StringValueCStr(rb_name), NUM2INT(rb_width), NUM2INT(rb_height),
+    NIL_P(rb_refresh_rate) ? 60 : NUM2INT(rb_refresh_rate));
+  if (monitor != NULL) {
+    rb_monitor = Data_Wrap_Struct(s_glfw_monitor_klass, 0, 0, monitor);
+    rb_obj_call_init(rb_monitor, 0, 0);
+  }
+  return rb_monitor;
 }
 
 
 
 /*
- * Gets the window for the current GL context in this thread.
+ * Disconnects the monitor, calling the monitor callback. Windows fullscreen on
+ * it become windowed.
  *
  * call-seq:
- *    current_context() -> Glfw::Window
- *
- * Wraps glfwGetCurrentContext.
+ *    disconnect_monitor(monitor) -> self
  */
-static VALUE rb_window_get_current_context(VALUE self)
+static VALUE rb_stub_disconnect_monitor(VALUE self, VALUE rb_monitor)
 {
-  return rb_lookup_window(glfwGetCurrentContext());
+  GLFWmonitor *monitor;
+  Data_Get_Struct(rb_monitor, GLFWmonitor, monitor);
+  glfwStubDisconnectMonitor(monitor);
+  return self;
 }
 
 
 
 /*
- * Swaps the front and back buffers for the window. You will typically call this
- * at the end of your drawing routines.
- *
- * Wraps glfwSwapBuffers.
- *
- *    loop {
- *      Glfw.poll_events()
- *
- *      # ...
+ * Connects a joystick with the given name, axis values (Floats), and button
+ * states (Integers), replacing whatever was connected before. Passing a nil
+ * name disconnects the joystick.
  *
- *      window.swap_buffers()
- *    }
+ * call-seq:
+ *    set_joystick(joystick, name, axes = [], buttons = []) -> self
  */
-static VALUE rb_window_swap_buffers(VALUE self)
+static VALUE rb_stub_set_joystick(int argc, VALUE *argv, VALUE self)
 {
-  glfwSwapBuffers(rb_get_window(self));
+  VALUE rb_joystick, rb_name, rb_axes, rb_buttons;
+  VALUE rb_axes_buffer = 0;
+  VALUE rb_buttons_buffer = 0;
+  float *axes = NULL;
+  unsigned char *buttons = NULL;
+  long axis_count = 0;
+  long button_count = 0;
+  long index = 0;
+
+  rb_scan_args(argc, argv, "22", &rb_joystick, &rb_name, &rb_axes, &rb_buttons);
+
+  if (NIL_P(rb_name)) {
+    glfwStubSetJoystick(NUM2INT(rb_joystick), NULL, NULL, 0, NULL, 0);
+    return self;
+  }
+
+  if (!NIL_P(rb_axes)) {
+    Check_Type(rb_axes, T_ARRAY);
+    axis_count = RARRAY_LEN(rb_axes);
+  }
+  if (!NIL_P(rb_buttons)) {
+    Check_Type(rb_buttons, T_ARRAY);
+    button_count = RARRAY_LEN(rb_buttons);
+  }
+  if (axis_count > INT_MAX || button_count > INT_MAX) {
+    rb_raise(rb_eArgError, "too many joystick axes or buttons");
+  }
+
+  axes = ALLOCV_N(float, rb_axes_buffer, axis_count + 1);
+  buttons = ALLOCV_N(unsigned char, rb_buttons_buffer, button_count + 1);
+  for (index = 0; index < axis_count; ++index) {
+    axes[index] = (float)NUM2DBL(rb_ary_entry(rb_axes, index));
+  }
+  for (index = 0; index < button_count; ++index) {
+    buttons[index] = (unsigned char)NUM2INT(rb_ary_entry(rb_buttons, index));
+  }
+
+  glfwStubSetJoystick(NUM2INT(rb_joystick), StringValueCStr(rb_name),
+    axes, (int)axis_count, buttons, (int)button_count);
+  ALLOCV_END(rb_axes_buffer);
+  ALLOCV_END(rb_buttons_buffer);
   return self;
 }
 
 
 
 /*
- * Sets the swap interval for the current context.
- * (See Glfw::Window#make_context_current)
+ * Returns the number of times the window's buffers have been swapped.
  *
  * call-seq:
- *    swap_interval=(interval) -> self
- *    swap_interval = interval -> self
- *
- * Wraps glfwSwapInterval.
+ *    swap_count(window) -> Integer
  */
-static VALUE rb_glfw_swap_interval(VALUE self, VALUE interval)
+static VALUE rb_stub_swap_count(VALUE self, VALUE rb_window)
 {
-  glfwSwapInterval(NUM2INT(interval));
-  return self;
+  return ULONG2NUM(glfwStubSwapCount(rb_get_window(rb_window)));
 }
 
 
 
 /*
- * Retursn whether a given OpenGL or context creation API extension is supported
- * by the current context.
- * (See Glfw::Window#make_context_current)
- *
- * Bear in mind that this function does not cache its results, so calls may be
- * expensive. If you find yourself using it, consider caching the results
- * yourself.
+ * Sets whether swapping a window's buffers fails with an error unless its
+ * context is current on the calling thread, as it does with EGL.
  *
  * call-seq:
- *    extension_supported?(extension) -> true or false
- *
- * Wraps glfwExtensionSupported.
+ *    strict_swap = strict -> strict
  */
-static VALUE rb_glfw_extension_supported(VALUE self, VALUE extension)
+static VALUE rb_stub_set_strict_swap(VALUE self, VALUE rb_strict)
 {
-  return glfwExtensionSupported(StringValueCStr(extension)) ? Qtrue : Qfalse;
+  glfwStubSetStrictSwap(RTEST(rb_strict));
+  return rb_strict;
 }
 
+#endif
+
 
 
 void Init_glfw3(void)
@@ -1561,12 +6275,28 @@ void Init_glfw3(void)
   kRB_RED                                   = rb_intern(kRB_RED_NAME);
   kRB_GREEN                                 = rb_intern(kRB_GREEN_NAME);
   kRB_BLUE                                  = rb_intern(kRB_BLUE_NAME);
+  kRB_POLL                                  = rb_intern(kRB_POLL_NAME);
+  kRB_WAIT                                  = rb_intern(kRB_WAIT_NAME);
+  kRB_TARGET_FPS                            = rb_intern(kRB_TARGET_FPS_NAME);
+  kRB_REALTIME                              = rb_intern(kRB_REALTIME_NAME);
+  kRB_SLEEP                                 = rb_intern(kRB_SLEEP_NAME);
+  kRB_ADAPTIVE                              = rb_intern(kRB_ADAPTIVE_NAME);
 
   s_glfw_module = rb_define_module("Glfw");
-  s_glfw_monitor_klass = rb_define_class_under(s_glfw_module, "Monitor", rb_cData);
+  s_glfw_monitor_klass = rb_define_class_under(s_glfw_module, "Monitor", rb_cObject);
   s_glfw_window_klass = rb_define_class_under(s_glfw_module, "Window", rb_cObject);
-  s_glfw_window_internal_klass = rb_define_class_under(s_glfw_window_klass, "InternalWindow", rb_cData);
-  s_glfw_videomode_klass = rb_define_class_under(s_glfw_module, "VideoMode", rb_cData);
+  s_glfw_window_internal_klass = rb_define_class_under(s_glfw_window_klass, "InternalWindow", rb_cObject);
+  s_glfw_videomode_klass = rb_define_class_under(s_glfw_module, "VideoMode", rb_cObject);
+  /* Only ever wrapped from C */
+  rb_undef_alloc_func(s_glfw_monitor_klass);
+  rb_undef_alloc_func(s_glfw_window_internal_klass);
+  rb_undef_alloc_func(s_glfw_videomode_klass);
+  s_glfw_clock_klass = rb_define_class_under(s_glfw_module, "Clock", rb_cObject);
+  s_glfw_hint_preset_klass = rb_define_class_under(s_glfw_window_klass, "HintPreset", rb_cObject);
+  s_glfw_window_snapshot_klass = rb_struct_define_under(s_glfw_window_klass, "Snapshot",
+    "should_close", "x", "y", "width", "height", "framebuffer_width", "framebuffer_height",
+    "cursor_x", "cursor_y", "cursor_mode", "sticky_keys", "sticky_mouse_buttons",
+    "focused", "iconified", NULL);
 
   /* Glfw::Monitor */
   rb_define_singleton_method(s_glfw_monitor_klass, "monitors", rb_glfw_get_monitors, 0);
@@ -1574,6 +6304,8 @@ void Init_glfw3(void)
   rb_define_method(s_glfw_monitor_klass, "name", rb_monitor_name, 0);
   rb_define_method(s_glfw_monitor_klass, "position", rb_monitor_position, 0);
   rb_define_method(s_glfw_monitor_klass, "physical_size", rb_monitor_physical_size, 0);
+  rb_define_method(s_glfw_monitor_klass, "position_into", rb_monitor_position_into, 1);
+  rb_define_method(s_glfw_monitor_klass, "physical_size_into", rb_monitor_physical_size_into, 1);
   rb_define_method(s_glfw_monitor_klass, "video_modes", rb_monitor_video_modes, 0);
   rb_define_method(s_glfw_monitor_klass, "video_mode", rb_monitor_video_mode, 0);
   rb_define_method(s_glfw_monitor_klass, "set_gamma", rb_monitor_set_gamma, 1);
@@ -1588,23 +6320,75 @@ void Init_glfw3(void)
   rb_define_method(s_glfw_videomode_klass, "blue_bits", rb_videomode_blue_bits, 0);
   rb_define_method(s_glfw_videomode_klass, "refresh_rate", rb_videomode_refresh_rate, 0);
 
+  /* Glfw::Clock */
+  rb_define_alloc_func(s_glfw_clock_klass, rb_glfw_clock_alloc);
+  rb_define_method(s_glfw_clock_klass, "initialize", rb_glfw_clock_initialize, -1);
+  rb_define_method(s_glfw_clock_klass, "tick", rb_glfw_clock_tick, 0);
+  rb_define_method(s_glfw_clock_klass, "alpha", rb_glfw_clock_alpha, 0);
+  rb_define_method(s_glfw_clock_klass, "step", rb_glfw_clock_step, 0);
+  rb_define_method(s_glfw_clock_klass, "total_steps", rb_glfw_clock_total_steps, 0);
+  rb_define_method(s_glfw_clock_klass, "pause", rb_glfw_clock_pause, 0);
+  rb_define_method(s_glfw_clock_klass, "resume", rb_glfw_clock_resume, 0);
+  rb_define_method(s_glfw_clock_klass, "paused?", rb_glfw_clock_paused, 0);
+  rb_define_method(s_glfw_clock_klass, "reset", rb_glfw_clock_reset, 0);
+
+  /* Glfw::Window::HintPreset */
+  rb_define_alloc_func(s_glfw_hint_preset_klass, rb_hint_preset_alloc);
+  rb_define_method(s_glfw_hint_preset_klass, "initialize", rb_hint_preset_initialize, -1);
+  rb_define_method(s_glfw_hint_preset_klass, "apply", rb_hint_preset_apply, 0);
+  rb_define_method(s_glfw_hint_preset_klass, "[]", rb_hint_preset_get, 1);
+  rb_define_method(s_glfw_hint_preset_klass, "to_h", rb_hint_preset_to_h, 0);
+
   /* Glfw::Window */
   rb_define_singleton_method(s_glfw_window_klass, "new", rb_window_new, -1);
   rb_define_singleton_method(s_glfw_window_klass, "window_hint", rb_window_window_hint, 2);
   rb_define_singleton_method(s_glfw_window_klass, "default_window_hints", rb_window_default_window_hints, 0);
   rb_define_singleton_method(s_glfw_window_klass, "unset_context", rb_window_unset_context, 0);
   rb_define_singleton_method(s_glfw_window_klass, "current_context", rb_window_get_current_context, 0);
+  rb_define_singleton_method(s_glfw_window_klass, "swap_all", rb_window_swap_all, 1);
+  rb_define_singleton_method(s_glfw_window_klass, "pool_limit=", rb_window_set_pool_limit, 1);
+  rb_define_singleton_method(s_glfw_window_klass, "pool_limit", rb_window_get_pool_limit, 0);
+  rb_define_singleton_method(s_glfw_window_klass, "pooled_count", rb_window_pooled_count, 0);
+  rb_define_singleton_method(s_glfw_window_klass, "drain_pool", rb_window_drain_pool, 0);
   rb_define_method(s_glfw_window_klass, "destroy", rb_window_destroy, 0);
   rb_define_method(s_glfw_window_klass, "get_should_close", rb_window_should_close, 0);
   rb_define_method(s_glfw_window_klass, "set_should_close", rb_window_set_should_close, 1);
   rb_define_method(s_glfw_window_klass, "make_context_current", rb_window_make_context_current, 0);
   rb_define_method(s_glfw_window_klass, "swap_buffers", rb_window_swap_buffers, 0);
+  rb_define_method(s_glfw_window_klass, "pace", rb_window_pace, 1);
+  rb_define_method(s_glfw_window_klass, "pause_when_hidden=", rb_window_set_pause_when_hidden, 1);
+  rb_define_method(s_glfw_window_klass, "pause_when_hidden?", rb_window_get_pause_when_hidden, 0);
+  rb_define_method(s_glfw_window_klass, "unfocused_hz=", rb_window_set_unfocused_hz, 1);
+  rb_define_method(s_glfw_window_klass, "unfocused_hz", rb_window_get_unfocused_hz, 0);
+  rb_define_method(s_glfw_window_klass, "throttled?", rb_window_is_throttled, 0);
+  rb_define_method(s_glfw_window_klass, "frame_due?", rb_window_is_frame_due, 0);
+  rb_define_method(s_glfw_window_klass, "needs_redraw?", rb_window_needs_redraw, 0);
+  rb_define_method(s_glfw_window_klass, "hint_preset", rb_window_get_hint_preset, 0);
+  rb_define_method(s_glfw_window_klass, "mark_dirty", rb_window_mark_dirty, 0);
+  rb_define_method(s_glfw_window_klass, "render_on_demand=", rb_window_set_render_on_demand, 1);
+  rb_define_method(s_glfw_window_klass, "render_on_demand?", rb_window_get_render_on_demand, 0);
   rb_define_method(s_glfw_window_klass, "title=", rb_window_set_title, 1);
   rb_define_method(s_glfw_window_klass, "get_position", rb_window_get_position, 0);
   rb_define_method(s_glfw_window_klass, "set_position", rb_window_set_position, 2);
   rb_define_method(s_glfw_window_klass, "get_size", rb_window_get_size, 0);
   rb_define_method(s_glfw_window_klass, "set_size", rb_window_set_size, 2);
+  rb_define_method(s_glfw_window_klass, "deferred_writes=", rb_window_set_deferred_writes, 1);
+  rb_define_method(s_glfw_window_klass, "deferred_writes?", rb_window_get_deferred_writes, 0);
+  rb_define_method(s_glfw_window_klass, "flush_writes", rb_window_flush_writes, 0);
   rb_define_method(s_glfw_window_klass, "framebuffer_size", rb_window_get_framebuffer_size, 0);
+  rb_define_method(s_glfw_window_klass, "get_position_into", rb_window_get_position_into, 1);
+  rb_define_method(s_glfw_window_klass, "get_size_into", rb_window_get_size_into, 1);
+  rb_define_method(s_glfw_window_klass, "framebuffer_size_into", rb_window_get_framebuffer_size_into, 1);
+  rb_define_method(s_glfw_window_klass, "x", rb_window_cached_x, 0);
+  rb_define_method(s_glfw_window_klass, "y", rb_window_cached_y, 0);
+  rb_define_method(s_glfw_window_klass, "width", rb_window_cached_width, 0);
+  rb_define_method(s_glfw_window_klass, "height", rb_window_cached_height, 0);
+  rb_define_method(s_glfw_window_klass, "framebuffer_width", rb_window_cached_fb_width, 0);
+  rb_define_method(s_glfw_window_klass, "framebuffer_height", rb_window_cached_fb_height, 0);
+  rb_define_method(s_glfw_window_klass, "focused?", rb_window_cached_focused, 0);
+  rb_define_method(s_glfw_window_klass, "iconified?", rb_window_cached_iconified, 0);
+  rb_define_method(s_glfw_window_klass, "refresh_cache", rb_window_refresh_cache, 0);
+  rb_define_method(s_glfw_window_klass, "snapshot", rb_window_snapshot, -1);
   rb_define_method(s_glfw_window_klass, "iconify", rb_window_iconify, 0);
   rb_define_method(s_glfw_window_klass, "restore", rb_window_restore, 0);
   rb_define_method(s_glfw_window_klass, "show", rb_window_show, 0);
@@ -1622,6 +6406,7 @@ void Init_glfw3(void)
   rb_define_method(s_glfw_window_klass, "key", rb_window_get_key, 1);
   rb_define_method(s_glfw_window_klass, "mouse_button", rb_window_get_mouse_button, 1);
   rb_define_method(s_glfw_window_klass, "get_cursor_pos", rb_window_get_cursor_pos, 0);
+  rb_define_method(s_glfw_window_klass, "get_cursor_pos_into", rb_window_get_cursor_pos_into, 1);
   rb_define_method(s_glfw_window_klass, "set_cursor_pos", rb_window_set_cursor_pos, 2);
   rb_define_method(s_glfw_window_klass, "set_key_callback__", rb_window_set_key_callback, 1);
   rb_define_method(s_glfw_window_klass, "set_char_callback__", rb_window_set_char_callback, 1);
@@ -1641,12 +6426,47 @@ void Init_glfw3(void)
   rb_define_singleton_method(s_glfw_module, "init", rb_glfw_init, 0);
   rb_define_singleton_method(s_glfw_module, "poll_events", rb_glfw_poll_events, 0);
   rb_define_singleton_method(s_glfw_module, "wait_events", rb_glfw_wait_events, 0);
+  rb_define_singleton_method(s_glfw_module, "event_fd", rb_glfw_get_event_fd, 0);
+  rb_define_singleton_method(s_glfw_module, "await_events", rb_glfw_await_events, -1);
+  rb_define_singleton_method(s_glfw_module, "post_empty_event", rb_glfw_post_empty_event, 0);
+  rb_define_singleton_method(s_glfw_module, "post_to_main", rb_glfw_post_to_main, 0);
+  rb_define_singleton_method(s_glfw_module, "pump_events", rb_glfw_pump_events_adaptive, -1);
+  rb_define_singleton_method(s_glfw_module, "redraw_until", rb_glfw_redraw_until, 1);
+  rb_define_singleton_method(s_glfw_module, "redraw_deadline", rb_glfw_get_redraw_deadline, 0);
+  rb_define_singleton_method(s_glfw_module, "input_linger=", rb_glfw_set_input_linger, 1);
+  rb_define_singleton_method(s_glfw_module, "input_linger", rb_glfw_get_input_linger, 0);
+  rb_define_singleton_method(s_glfw_module, "run", rb_glfw_run, -1);
+  rb_define_singleton_method(s_glfw_module, "frame_stats_enabled=", rb_glfw_set_frame_stats_enabled, 1);
+  rb_define_singleton_method(s_glfw_module, "frame_stats_enabled?", rb_glfw_get_frame_stats_enabled, 0);
+  rb_define_singleton_method(s_glfw_module, "frame_stats", rb_glfw_frame_stats, 0);
+  rb_define_singleton_method(s_glfw_module, "reset_frame_stats", rb_glfw_reset_frame_stats, 0);
+  rb_define_singleton_method(s_glfw_module, "callback_stats_enabled=", rb_glfw_set_callback_stats_enabled, 1);
+  rb_define_singleton_method(s_glfw_module, "callback_stats_enabled?", rb_glfw_get_callback_stats_enabled, 0);
+  rb_define_singleton_method(s_glfw_module, "callback_stats", rb_glfw_callback_stats, 0);
+  rb_define_singleton_method(s_glfw_module, "reset_callback_stats", rb_glfw_reset_callback_stats, 0);
+  rb_define_singleton_method(s_glfw_module, "input_latency_enabled=", rb_glfw_set_input_latency_enabled, 1);
+  rb_define_singleton_method(s_glfw_module, "input_latency_enabled?", rb_glfw_get_input_latency_enabled, 0);
+  rb_define_singleton_method(s_glfw_module, "event_time_ns", rb_glfw_event_time_ns, 0);
+  rb_define_singleton_method(s_glfw_module, "input_latency", rb_glfw_input_latency, 0);
+  rb_define_singleton_method(s_glfw_module, "reset_input_latency", rb_glfw_reset_input_latency, 0);
+  rb_define_singleton_method(s_glfw_module, "start_trace", rb_glfw_start_trace, -1);
+  rb_define_singleton_method(s_glfw_module, "stop_trace", rb_glfw_stop_trace, 0);
+  rb_define_singleton_method(s_glfw_module, "tracing?", rb_glfw_get_tracing, 0);
+  rb_define_singleton_method(s_glfw_module, "write_trace", rb_glfw_write_trace, 1);
+  rb_define_singleton_method(s_glfw_module, "start_recording", rb_glfw_start_recording, 1);
+  rb_define_singleton_method(s_glfw_module, "stop_recording", rb_glfw_stop_recording, 0);
+  rb_define_singleton_method(s_glfw_module, "recording?", rb_glfw_get_recording, 0);
+  rb_define_singleton_method(s_glfw_module, "replay_events", rb_glfw_replay_events, -1);
   rb_define_singleton_method(s_glfw_module, "joystick_present?", rb_glfw_joystick_present, 1);
   rb_define_singleton_method(s_glfw_module, "joystick_axes", rb_glfw_get_joystick_axes, 1);
   rb_define_singleton_method(s_glfw_module, "joystick_buttons", rb_glfw_get_joystick_buttons, 1);
   rb_define_singleton_method(s_glfw_module, "joystick_name", rb_glfw_get_joystick_name, 1);
   rb_define_singleton_method(s_glfw_module, "time", rb_glfw_get_time, 0);
   rb_define_singleton_method(s_glfw_module, "time=", rb_glfw_set_time, 1);
+  rb_define_singleton_method(s_glfw_module, "time_ns", rb_glfw_get_time_ns, 0);
+  rb_define_singleton_method(s_glfw_module, "time_ns=", rb_glfw_set_time_ns, 1);
+  rb_define_singleton_method(s_glfw_module, "timer_value", rb_glfw_get_timer_value, 0);
+  rb_define_singleton_method(s_glfw_module, "timer_frequency", rb_glfw_get_timer_frequency, 0);
   rb_define_singleton_method(s_glfw_module, "swap_interval=", rb_glfw_swap_interval, 1);
   rb_define_singleton_method(s_glfw_module, "extension_supported?", rb_glfw_extension_supported, 1);
 
@@ -1866,6 +6686,25 @@ void Init_glfw3(void)
   rb_const_set(s_glfw_module, rb_intern("CONNECTED"), INT2FIX(GLFW_CONNECTED));
   rb_const_set(s_glfw_module, rb_intern("DISCONNECTED"), INT2FIX(GLFW_DISCONNECTED));
 
+  s_main_queue = rb_ary_new();
+  rb_global_variable(&s_main_queue);
+  rb_glfw_init_wakeup();
+  rb_glfw_reset_hints();
+
+#ifdef GLFW_STUB
+  /* Glfw::Stub */
+  s_glfw_stub_module = rb_define_module_under(s_glfw_module, "Stub");
+  rb_define_singleton_method(s_glfw_stub_module, "post_event", rb_stub_post_event, -1);
+  rb_define_singleton_method(s_glfw_stub_module, "pending_events", rb_stub_pending_events, 0);
+  rb_define_singleton_method(s_glfw_stub_module, "clock_rate=", rb_stub_set_clock_rate, 1);
+  rb_define_singleton_method(s_glfw_stub_module, "advance_time", rb_stub_advance_time, 1);
+  rb_define_singleton_method(s_glfw_stub_module, "connect_monitor", rb_stub_connect_monitor, -1);
+  rb_define_singleton_method(s_glfw_stub_module, "disconnect_monitor", rb_stub_disconnect_monitor, 1);
+  rb_define_singleton_method(s_glfw_stub_module, "set_joystick", rb_stub_set_joystick, -1);
+  rb_define_singleton_method(s_glfw_stub_module, "swap_count", rb_stub_swap_count, 1);
+  rb_define_singleton_method(s_glfw_stub_module, "strict_swap=", rb_stub_set_strict_swap, 1);
+#endif
+
   glfwSetErrorCallback(rb_glfw_error_callback);
 }
 
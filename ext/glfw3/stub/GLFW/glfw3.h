@@ -0,0 +1,405 @@
+/*
+ * GLFW 3.0 API declarations for the headless stub backend (see glfw_stub.c).
+ * The constants match GLFW 3.0's so the bindings behave the same against
+ * either. Only built when the extension is configured with --enable-stub.
+ */
+
+#ifndef _glfw3_h_
+#define _glfw3_h_
+
+/* Defined when building against the stub rather than a real GLFW */
+#define GLFW_STUB 1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+#define GLFW_VERSION_MAJOR 3
+#define GLFW_VERSION_MINOR 0
+#define GLFW_VERSION_REVISION 4
+#ifndef GL_TRUE
+#define GL_TRUE 1
+#define GL_FALSE 0
+#endif
+#define GLFW_RELEASE 0
+#define GLFW_PRESS 1
+#define GLFW_REPEAT 2
+#define GLFW_KEY_UNKNOWN -1
+#define GLFW_KEY_SPACE 32
+#define GLFW_KEY_APOSTROPHE 39
+#define GLFW_KEY_COMMA 44
+#define GLFW_KEY_MINUS 45
+#define GLFW_KEY_PERIOD 46
+#define GLFW_KEY_SLASH 47
+#define GLFW_KEY_0 48
+#define GLFW_KEY_1 49
+#define GLFW_KEY_2 50
+#define GLFW_KEY_3 51
+#define GLFW_KEY_4 52
+#define GLFW_KEY_5 53
+#define GLFW_KEY_6 54
+#define GLFW_KEY_7 55
+#define GLFW_KEY_8 56
+#define GLFW_KEY_9 57
+#define GLFW_KEY_SEMICOLON 59
+#define GLFW_KEY_EQUAL 61
+#define GLFW_KEY_A 65
+#define GLFW_KEY_B 66
+#define GLFW_KEY_C 67
+#define GLFW_KEY_D 68
+#define GLFW_KEY_E 69
+#define GLFW_KEY_F 70
+#define GLFW_KEY_G 71
+#define GLFW_KEY_H 72
+#define GLFW_KEY_I 73
+#define GLFW_KEY_J 74
+#define GLFW_KEY_K 75
+#define GLFW_KEY_L 76
+#define GLFW_KEY_M 77
+#define GLFW_KEY_N 78
+#define GLFW_KEY_O 79
+#define GLFW_KEY_P 80
+#define GLFW_KEY_Q 81
+#define GLFW_KEY_R 82
+#define GLFW_KEY_S 83
+#define GLFW_KEY_T 84
+#define GLFW_KEY_U 85
+#define GLFW_KEY_V 86
+#define GLFW_KEY_W 87
+#define GLFW_KEY_X 88
+#define GLFW_KEY_Y 89
+#define GLFW_KEY_Z 90
+#define GLFW_KEY_LEFT_BRACKET 91
+#define GLFW_KEY_BACKSLASH 92
+#define GLFW_KEY_RIGHT_BRACKET 93
+#define GLFW_KEY_GRAVE_ACCENT 96
+#define GLFW_KEY_WORLD_1 161
+#define GLFW_KEY_WORLD_2 162
+#define GLFW_KEY_ESCAPE 256
+#define GLFW_KEY_ENTER 257
+#define GLFW_KEY_TAB 258
+#define GLFW_KEY_BACKSPACE 259
+#define GLFW_KEY_INSERT 260
+#define GLFW_KEY_DELETE 261
+#define GLFW_KEY_RIGHT 262
+#define GLFW_KEY_LEFT 263
+#define GLFW_KEY_DOWN 264
+#define GLFW_KEY_UP 265
+#define GLFW_KEY_PAGE_UP 266
+#define GLFW_KEY_PAGE_DOWN 267
+#define GLFW_KEY_HOME 268
+#define GLFW_KEY_END 269
+#define GLFW_KEY_CAPS_LOCK 280
+#define GLFW_KEY_SCROLL_LOCK 281
+#define GLFW_KEY_NUM_LOCK 282
+#define GLFW_KEY_PRINT_SCREEN 283
+#define GLFW_KEY_PAUSE 284
+#define GLFW_KEY_F1 290
+#define GLFW_KEY_F2 291
+#define GLFW_KEY_F3 292
+#define GLFW_KEY_F4 293
+#define GLFW_KEY_F5 294
+#define GLFW_KEY_F6 295
+#define GLFW_KEY_F7 296
+#define GLFW_KEY_F8 297
+#define GLFW_KEY_F9 298
+#define GLFW_KEY_F10 299
+#define GLFW_KEY_F11 300
+#define GLFW_KEY_F12 301
+#define GLFW_KEY_F13 302
+#define GLFW_KEY_F14 303
+#define GLFW_KEY_F15 304
+#define GLFW_KEY_F16 305
+#define GLFW_KEY_F17 306
+#define GLFW_KEY_F18 307
+#define GLFW_KEY_F19 308
+#define GLFW_KEY_F20 309
+#define GLFW_KEY_F21 310
+#define GLFW_KEY_F22 311
+#define GLFW_KEY_F23 312
+#define GLFW_KEY_F24 313
+#define GLFW_KEY_F25 314
+#define GLFW_KEY_KP_0 320
+#define GLFW_KEY_KP_1 321
+#define GLFW_KEY_KP_2 322
+#define GLFW_KEY_KP_3 323
+#define GLFW_KEY_KP_4 324
+#define GLFW_KEY_KP_5 325
+#define GLFW_KEY_KP_6 326
+#define GLFW_KEY_KP_7 327
+#define GLFW_KEY_KP_8 328
+#define GLFW_KEY_KP_9 329
+#define GLFW_KEY_KP_DECIMAL 330
+#define GLFW_KEY_KP_DIVIDE 331
+#define GLFW_KEY_KP_MULTIPLY 332
+#define GLFW_KEY_KP_SUBTRACT 333
+#define GLFW_KEY_KP_ADD 334
+#define GLFW_KEY_KP_ENTER 335
+#define GLFW_KEY_KP_EQUAL 336
+#define GLFW_KEY_LEFT_SHIFT 340
+#define GLFW_KEY_LEFT_CONTROL 341
+#define GLFW_KEY_LEFT_ALT 342
+#define GLFW_KEY_LEFT_SUPER 343
+#define GLFW_KEY_RIGHT_SHIFT 344
+#define GLFW_KEY_RIGHT_CONTROL 345
+#define GLFW_KEY_RIGHT_ALT 346
+#define GLFW_KEY_RIGHT_SUPER 347
+#define GLFW_KEY_MENU 348
+#define GLFW_KEY_LAST GLFW_KEY_MENU
+#define GLFW_MOD_SHIFT 0x0001
+#define GLFW_MOD_CONTROL 0x0002
+#define GLFW_MOD_ALT 0x0004
+#define GLFW_MOD_SUPER 0x0008
+#define GLFW_MOUSE_BUTTON_1 0
+#define GLFW_MOUSE_BUTTON_2 1
+#define GLFW_MOUSE_BUTTON_3 2
+#define GLFW_MOUSE_BUTTON_4 3
+#define GLFW_MOUSE_BUTTON_5 4
+#define GLFW_MOUSE_BUTTON_6 5
+#define GLFW_MOUSE_BUTTON_7 6
+#define GLFW_MOUSE_BUTTON_8 7
+#define GLFW_MOUSE_BUTTON_LAST GLFW_MOUSE_BUTTON_8
+#define GLFW_MOUSE_BUTTON_LEFT GLFW_MOUSE_BUTTON_1
+#define GLFW_MOUSE_BUTTON_RIGHT GLFW_MOUSE_BUTTON_2
+#define GLFW_MOUSE_BUTTON_MIDDLE GLFW_MOUSE_BUTTON_3
+#define GLFW_JOYSTICK_1 0
+#define GLFW_JOYSTICK_2 1
+#define GLFW_JOYSTICK_3 2
+#define GLFW_JOYSTICK_4 3
+#define GLFW_JOYSTICK_5 4
+#define GLFW_JOYSTICK_6 5
+#define GLFW_JOYSTICK_7 6
+#define GLFW_JOYSTICK_8 7
+#define GLFW_JOYSTICK_9 8
+#define GLFW_JOYSTICK_10 9
+#define GLFW_JOYSTICK_11 10
+#define GLFW_JOYSTICK_12 11
+#define GLFW_JOYSTICK_13 12
+#define GLFW_JOYSTICK_14 13
+#define GLFW_JOYSTICK_15 14
+#define GLFW_JOYSTICK_16 15
+#define GLFW_JOYSTICK_LAST GLFW_JOYSTICK_16
+#define GLFW_NOT_INITIALIZED 0x00010001
+#define GLFW_NO_CURRENT_CONTEXT 0x00010002
+#define GLFW_INVALID_ENUM 0x00010003
+#define GLFW_INVALID_VALUE 0x00010004
+#define GLFW_OUT_OF_MEMORY 0x00010005
+#define GLFW_API_UNAVAILABLE 0x00010006
+#define GLFW_VERSION_UNAVAILABLE 0x00010007
+#define GLFW_PLATFORM_ERROR 0x00010008
+#define GLFW_FORMAT_UNAVAILABLE 0x00010009
+#define GLFW_FOCUSED 0x00020001
+#define GLFW_ICONIFIED 0x00020002
+#define GLFW_RESIZABLE 0x00020003
+#define GLFW_VISIBLE 0x00020004
+#define GLFW_DECORATED 0x00020005
+#define GLFW_RED_BITS 0x00021001
+#define GLFW_GREEN_BITS 0x00021002
+#define GLFW_BLUE_BITS 0x00021003
+#define GLFW_ALPHA_BITS 0x00021004
+#define GLFW_DEPTH_BITS 0x00021005
+#define GLFW_STENCIL_BITS 0x00021006
+#define GLFW_ACCUM_RED_BITS 0x00021007
+#define GLFW_ACCUM_GREEN_BITS 0x00021008
+#define GLFW_ACCUM_BLUE_BITS 0x00021009
+#define GLFW_ACCUM_ALPHA_BITS 0x0002100A
+#define GLFW_AUX_BUFFERS 0x0002100B
+#define GLFW_STEREO 0x0002100C
+#define GLFW_SAMPLES 0x0002100D
+#define GLFW_SRGB_CAPABLE 0x0002100E
+#define GLFW_REFRESH_RATE 0x0002100F
+#define GLFW_CLIENT_API 0x00022001
+#define GLFW_CONTEXT_VERSION_MAJOR 0x00022002
+#define GLFW_CONTEXT_VERSION_MINOR 0x00022003
+#define GLFW_CONTEXT_REVISION 0x00022004
+#define GLFW_CONTEXT_ROBUSTNESS 0x00022005
+#define GLFW_OPENGL_FORWARD_COMPAT 0x00022006
+#define GLFW_OPENGL_DEBUG_CONTEXT 0x00022007
+#define GLFW_OPENGL_PROFILE 0x00022008
+#define GLFW_OPENGL_API 0x00030001
+#define GLFW_OPENGL_ES_API 0x00030002
+#define GLFW_NO_ROBUSTNESS 0
+#define GLFW_NO_RESET_NOTIFICATION 0x00031001
+#define GLFW_LOSE_CONTEXT_ON_RESET 0x00031002
+#define GLFW_OPENGL_ANY_PROFILE 0
+#define GLFW_OPENGL_CORE_PROFILE 0x00032001
+#define GLFW_OPENGL_COMPAT_PROFILE 0x00032002
+#define GLFW_CURSOR 0x00033001
+#define GLFW_STICKY_KEYS 0x00033002
+#define GLFW_STICKY_MOUSE_BUTTONS 0x00033003
+#define GLFW_CURSOR_NORMAL 0x00034001
+#define GLFW_CURSOR_HIDDEN 0x00034002
+#define GLFW_CURSOR_DISABLED 0x00034003
+#define GLFW_CONNECTED 0x00040001
+#define GLFW_DISCONNECTED 0x00040002
+
+typedef void (*GLFWglproc)(void);
+typedef struct GLFWmonitor GLFWmonitor;
+typedef struct GLFWwindow GLFWwindow;
+typedef void (*GLFWerrorfun)(int, const char *);
+typedef void (*GLFWwindowposfun)(GLFWwindow *, int, int);
+typedef void (*GLFWwindowsizefun)(GLFWwindow *, int, int);
+typedef void (*GLFWwindowclosefun)(GLFWwindow *);
+typedef void (*GLFWwindowrefreshfun)(GLFWwindow *);
+typedef void (*GLFWwindowfocusfun)(GLFWwindow *, int);
+typedef void (*GLFWwindowiconifyfun)(GLFWwindow *, int);
+typedef void (*GLFWframebuffersizefun)(GLFWwindow *, int, int);
+typedef void (*GLFWmousebuttonfun)(GLFWwindow *, int, int, int);
+typedef void (*GLFWcursorposfun)(GLFWwindow *, double, double);
+typedef void (*GLFWcursorenterfun)(GLFWwindow *, int);
+typedef void (*GLFWscrollfun)(GLFWwindow *, double, double);
+typedef void (*GLFWkeyfun)(GLFWwindow *, int, int, int, int);
+typedef void (*GLFWcharfun)(GLFWwindow *, unsigned int);
+typedef void (*GLFWmonitorfun)(GLFWmonitor *, int);
+
+typedef struct GLFWvidmode {
+  int width;
+  int height;
+  int redBits;
+  int greenBits;
+  int blueBits;
+  int refreshRate;
+} GLFWvidmode;
+
+typedef struct GLFWgammaramp {
+  unsigned short *red;
+  unsigned short *green;
+  unsigned short *blue;
+  unsigned int size;
+} GLFWgammaramp;
+
+int glfwInit(void);
+void glfwTerminate(void);
+void glfwGetVersion(int *major, int *minor, int *rev);
+const char *glfwGetVersionString(void);
+GLFWerrorfun glfwSetErrorCallback(GLFWerrorfun cbfun);
+GLFWmonitor **glfwGetMonitors(int *count);
+GLFWmonitor *glfwGetPrimaryMonitor(void);
+void glfwGetMonitorPos(GLFWmonitor *monitor, int *xpos, int *ypos);
+void glfwGetMonitorPhysicalSize(GLFWmonitor *monitor, int *width, int *height);
+const char *glfwGetMonitorName(GLFWmonitor *monitor);
+GLFWmonitorfun glfwSetMonitorCallback(GLFWmonitorfun cbfun);
+const GLFWvidmode *glfwGetVideoModes(GLFWmonitor *monitor, int *count);
+const GLFWvidmode *glfwGetVideoMode(GLFWmonitor *monitor);
+void glfwSetGamma(GLFWmonitor *monitor, float gamma);
+const GLFWgammaramp *glfwGetGammaRamp(GLFWmonitor *monitor);
+void glfwSetGammaRamp(GLFWmonitor *monitor, const GLFWgammaramp *ramp);
+void glfwDefaultWindowHints(void);
+void glfwWindowHint(int target, int hint);
+GLFWwindow *glfwCreateWindow(int width, int height, const char *title, GLFWmonitor *monitor, GLFWwindow *share);
+void glfwDestroyWindow(GLFWwindow *window);
+int glfwWindowShouldClose(GLFWwindow *window);
+void glfwSetWindowShouldClose(GLFWwindow *window, int value);
+void glfwSetWindowTitle(GLFWwindow *window, const char *title);
+void glfwGetWindowPos(GLFWwindow *window, int *xpos, int *ypos);
+void glfwSetWindowPos(GLFWwindow *window, int xpos, int ypos);
+void glfwGetWindowSize(GLFWwindow *window, int *width, int *height);
+void glfwSetWindowSize(GLFWwindow *window, int width, int height);
+void glfwGetFramebufferSize(GLFWwindow *window, int *width, int *height);
+void glfwIconifyWindow(GLFWwindow *window);
+void glfwRestoreWindow(GLFWwindow *window);
+void glfwShowWindow(GLFWwindow *window);
+void glfwHideWindow(GLFWwindow *window);
+GLFWmonitor *glfwGetWindowMonitor(GLFWwindow *window);
+int glfwGetWindowAttrib(GLFWwindow *window, int attrib);
+void glfwSetWindowUserPointer(GLFWwindow *window, void *pointer);
+void *glfwGetWindowUserPointer(GLFWwindow *window);
+GLFWwindowposfun glfwSetWindowPosCallback(GLFWwindow *window, GLFWwindowposfun cbfun);
+GLFWwindowsizefun glfwSetWindowSizeCallback(GLFWwindow *window, GLFWwindowsizefun cbfun);
+GLFWwindowclosefun glfwSetWindowCloseCallback(GLFWwindow *window, GLFWwindowclosefun cbfun);
+GLFWwindowrefreshfun glfwSetWindowRefreshCallback(GLFWwindow *window, GLFWwindowrefreshfun cbfun);
+GLFWwindowfocusfun glfwSetWindowFocusCallback(GLFWwindow *window, GLFWwindowfocusfun cbfun);
+GLFWwindowiconifyfun glfwSetWindowIconifyCallback(GLFWwindow *window, GLFWwindowiconifyfun cbfun);
+GLFWframebuffersizefun glfwSetFramebufferSizeCallback(GLFWwindow *window, GLFWframebuffersizefun cbfun);
+void glfwPollEvents(void);
+void glfwWaitEvents(void);
+int glfwGetInputMode(GLFWwindow *window, int mode);
+void glfwSetInputMode(GLFWwindow *window, int mode, int value);
+int glfwGetKey(GLFWwindow *window, int key);
+int glfwGetMouseButton(GLFWwindow *window, int button);
+void glfwGetCursorPos(GLFWwindow *window, double *xpos, double *ypos);
+void glfwSetCursorPos(GLFWwindow *window, double xpos, double ypos);
+GLFWkeyfun glfwSetKeyCallback(GLFWwindow *window, GLFWkeyfun cbfun);
+GLFWcharfun glfwSetCharCallback(GLFWwindow *window, GLFWcharfun cbfun);
+GLFWmousebuttonfun glfwSetMouseButtonCallback(GLFWwindow *window, GLFWmousebuttonfun cbfun);
+GLFWcursorposfun glfwSetCursorPosCallback(GLFWwindow *window, GLFWcursorposfun cbfun);
+GLFWcursorenterfun glfwSetCursorEnterCallback(GLFWwindow *window, GLFWcursorenterfun cbfun);
+GLFWscrollfun glfwSetScrollCallback(GLFWwindow *window, GLFWscrollfun cbfun);
+int glfwJoystickPresent(int joy);
+const float *glfwGetJoystickAxes(int joy, int *count);
+const unsigned char *glfwGetJoystickButtons(int joy, int *count);
+const char *glfwGetJoystickName(int joy);
+void glfwSetClipboardString(GLFWwindow *window, const char *string);
+const char *glfwGetClipboardString(GLFWwindow *window);
+double glfwGetTime(void);
+void glfwSetTime(double time);
+void glfwMakeContextCurrent(GLFWwindow *window);
+GLFWwindow *glfwGetCurrentContext(void);
+void glfwSwapBuffers(GLFWwindow *window);
+void glfwSwapInterval(int interval);
+int glfwExtensionSupported(const char *extension);
+GLFWglproc glfwGetProcAddress(const char *procname);
+
+/* From GLFW 3.2; the stub provides these so its clock can be controlled */
+unsigned long long glfwGetTimerValue(void);
+unsigned long long glfwGetTimerFrequency(void);
+
+
+/*
+ * Stub control API. Not part of GLFW; used by the bindings' Glfw::Stub module
+ * to drive the simulated windowing system.
+ */
+
+enum {
+  GLFW_STUB_EVENT_KEY,
+  GLFW_STUB_EVENT_CHAR,
+  GLFW_STUB_EVENT_MOUSE_BUTTON,
+  GLFW_STUB_EVENT_CURSOR_POS,
+  GLFW_STUB_EVENT_CURSOR_ENTER,
+  GLFW_STUB_EVENT_SCROLL,
+  GLFW_STUB_EVENT_WINDOW_POS,
+  GLFW_STUB_EVENT_WINDOW_SIZE,
+  GLFW_STUB_EVENT_WINDOW_CLOSE,
+  GLFW_STUB_EVENT_WINDOW_REFRESH,
+  GLFW_STUB_EVENT_WINDOW_FOCUS,
+  GLFW_STUB_EVENT_WINDOW_ICONIFY,
+  GLFW_STUB_EVENT_FRAMEBUFFER_SIZE
+};
+
+/*
+ * An injected event. Integer arguments go in i in callback order (e.g. key,
+ * scancode, action, mods); cursor position and scroll offsets go in d.
+ */
+typedef struct GLFWstubevent {
+  int type;
+  GLFWwindow *window;
+  int i[4];
+  double d[2];
+} GLFWstubevent;
+
+/* Queues an event for delivery by the next glfwPollEvents/glfwWaitEvents. */
+void glfwStubPostEvent(const GLFWstubevent *event);
+/* Number of events queued and not yet delivered. */
+int glfwStubPendingEvents(void);
+/* Descriptor that's readable while events are queued, or -1 (e.g. on Windows). */
+int glfwStubEventFd(void);
+/* Speed of the clock relative to real time; 0 freezes it. Defaults to 1. */
+void glfwStubSetClockRate(double rate);
+/* Moves the clock forward by the given number of seconds. */
+void glfwStubAdvanceTime(double seconds);
+/* Adds a monitor with a single video mode and notifies the monitor callback. */
+GLFWmonitor *glfwStubConnectMonitor(const char *name, int width, int height, int refresh_rate);
+/* Removes a monitor and notifies the monitor callback. */
+void glfwStubDisconnectMonitor(GLFWmonitor *monitor);
+/* Connects a joystick, or disconnects it if name is NULL. */
+void glfwStubSetJoystick(int joy, const char *name, const float *axes, int axis_count,
+                         const unsigned char *buttons, int button_count);
+/* Number of times glfwSwapBuffers has been called for the window. */
+unsigned long glfwStubSwapCount(GLFWwindow *window);
+/* Whether glfwSwapBuffers fails unless the window's context is current on the
+   calling thread, as with EGL. Defaults to 0. */
+void glfwStubSetStrictSwap(int strict);
+
+#ifdef __cplusplus
+}
+#endif
+#endif
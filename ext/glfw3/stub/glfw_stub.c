@@ -0,0 +1,1208 @@
+/*
+ * Headless stub implementation of the GLFW 3.0 API, for exercising and
+ * benchmarking the bindings on machines without a display or GPU. Built in
+ * place of the system GLFW when the extension is configured with --enable-stub.
+ *
+ * Windows, monitors (with video modes and gamma ramps), joysticks, the
+ * clipboard, and the clock are all simulated in memory. Nothing happens on its
+ * own: events are queued with glfwStubPostEvent and delivered through the
+ * installed callbacks by the next glfwPollEvents or glfwWaitEvents, and
+ * glfwWaitEvents returns immediately if nothing is queued rather than
+ * blocking. Like real GLFW, setting a window's position or size, iconifying
+ * it, or restoring it queues the matching event instead of calling back
+ * immediately.
+ *
+ * All of it assumes it's only called from one thread, same as GLFW's own
+ * main-thread-only functions, except that (as in GLFW) each thread has its own
+ * current context.
+ */
+
+#include <GLFW/glfw3.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+
+/* Key and mouse button state for a released key with sticky input enabled */
+#define STUB_STICK 3
+
+typedef struct stub_hints {
+  int resizable;
+  int visible;
+  int decorated;
+  int red_bits;
+  int green_bits;
+  int blue_bits;
+  int alpha_bits;
+  int depth_bits;
+  int stencil_bits;
+  int samples;
+  int refresh_rate;
+  int client_api;
+  int context_major;
+  int context_minor;
+  int context_robustness;
+  int forward_compat;
+  int debug_context;
+  int profile;
+} stub_hints_t;
+
+struct GLFWmonitor {
+  /* Every monitor ever connected, so disconnected ones can be freed later */
+  GLFWmonitor *next_allocated;
+  char *name;
+  int connected;
+  int x;
+  int y;
+  int width_mm;
+  int height_mm;
+  GLFWvidmode *modes;
+  int mode_count;
+  int current_mode;
+  GLFWgammaramp ramp;
+};
+
+struct GLFWwindow {
+  GLFWwindow *next;
+  stub_hints_t hints;
+  char *title;
+  GLFWmonitor *monitor;
+  void *user_pointer;
+  int x;
+  int y;
+  int width;
+  int height;
+  int fb_width;
+  int fb_height;
+  int should_close;
+  int visible;
+  int iconified;
+  int focused;
+  int cursor_mode;
+  int sticky_keys;
+  int sticky_mouse_buttons;
+  char keys[GLFW_KEY_LAST + 1];
+  char mouse_buttons[GLFW_MOUSE_BUTTON_LAST + 1];
+  double cursor_x;
+  double cursor_y;
+  unsigned long swap_count;
+
+  GLFWwindowposfun pos_callback;
+  GLFWwindowsizefun size_callback;
+  GLFWwindowclosefun close_callback;
+  GLFWwindowrefreshfun refresh_callback;
+  GLFWwindowfocusfun focus_callback;
+  GLFWwindowiconifyfun iconify_callback;
+  GLFWframebuffersizefun fbsize_callback;
+  GLFWmousebuttonfun mouse_button_callback;
+  GLFWcursorposfun cursor_pos_callback;
+  GLFWcursorenterfun cursor_enter_callback;
+  GLFWscrollfun scroll_callback;
+  GLFWkeyfun key_callback;
+  GLFWcharfun char_callback;
+};
+
+typedef struct stub_joystick {
+  char *name;
+  float *axes;
+  int axis_count;
+  unsigned char *buttons;
+  int button_count;
+} stub_joystick_t;
+
+static int s_initialized = 0;
+static GLFWerrorfun s_error_callback = NULL;
+static GLFWmonitorfun s_monitor_callback = NULL;
+static stub_hints_t s_hints;
+static GLFWwindow *s_windows = NULL;
+/* Like GLFW's, the current context is per thread */
+#if defined(_MSC_VER)
+static __declspec(thread) GLFWwindow *s_current_context = NULL;
+#else
+static __thread GLFWwindow *s_current_context = NULL;
+#endif
+static GLFWmonitor *s_allocated_monitors = NULL;
+static GLFWmonitor **s_monitors = NULL;
+static int s_monitor_count = 0;
+static stub_joystick_t s_joysticks[GLFW_JOYSTICK_LAST + 1];
+static char *s_clipboard = NULL;
+static int s_strict_swap = 0;
+
+static GLFWstubevent *s_events = NULL;
+static int s_event_head = 0;
+static int s_event_count = 0;
+static int s_event_capacity = 0;
+/* Pipe that holds one byte while events are queued, see glfwStubEventFd */
+static int s_event_pipe[2] = { -1, -1 };
+static int s_event_signalled = 0;
+
+/*
+ * The stub clock runs at s_clock_rate times real time. s_clock_base is its
+ * reading, in nanoseconds, at the real time s_clock_real_base.
+ */
+static int s_clock_started = 0;
+static double s_clock_rate = 1.0;
+static unsigned long long s_clock_base = 0;
+static unsigned long long s_clock_real_base = 0;
+static unsigned long long s_time_offset = 0;
+
+
+
+static void stub_error(int code, const char *description)
+{
+  if (s_error_callback) {
+    s_error_callback(code, description);
+  }
+}
+
+static int stub_require_init(void)
+{
+  if (!s_initialized) {
+    stub_error(GLFW_NOT_INITIALIZED, "The GLFW library is not initialized");
+    return 0;
+  }
+  return 1;
+}
+
+static char *stub_strdup(const char *string)
+{
+  size_t length = strlen(string) + 1;
+  char *copy = (char *)malloc(length);
+  memcpy(copy, string, length);
+  return copy;
+}
+
+
+
+/* Clock */
+
+static unsigned long long stub_real_ns(void)
+{
+#ifdef _WIN32
+  LARGE_INTEGER counter, frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return (unsigned long long)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long long)now.tv_sec * 1000000000ULL + (unsigned long long)now.tv_nsec;
+#endif
+}
+
+/* Folds elapsed real time into s_clock_base so the rate can change. */
+static void stub_clock_rebase(void)
+{
+  unsigned long long real_now = stub_real_ns();
+  if (!s_clock_started) {
+    s_clock_started = 1;
+  } else {
+    s_clock_base += (unsigned long long)((double)(real_now - s_clock_real_base) * s_clock_rate);
+  }
+  s_clock_real_base = real_now;
+}
+
+unsigned long long glfwGetTimerValue(void)
+{
+  if (!s_clock_started) {
+    stub_clock_rebase();
+  }
+  return s_clock_base +
+         (unsigned long long)((double)(stub_real_ns() - s_clock_real_base) * s_clock_rate);
+}
+
+unsigned long long glfwGetTimerFrequency(void)
+{
+  return 1000000000ULL;
+}
+
+double glfwGetTime(void)
+{
+  return (double)(glfwGetTimerValue() - s_time_offset) * 1e-9;
+}
+
+void glfwSetTime(double time)
+{
+  if (time < 0.0) {
+    stub_error(GLFW_INVALID_VALUE, "Invalid time");
+    return;
+  }
+  s_time_offset = glfwGetTimerValue() - (unsigned long long)(time * 1e9);
+}
+
+void glfwStubSetClockRate(double rate)
+{
+  stub_clock_rebase();
+  s_clock_rate = rate < 0.0 ? 0.0 : rate;
+}
+
+void glfwStubAdvanceTime(double seconds)
+{
+  stub_clock_rebase();
+  if (seconds > 0.0) {
+    s_clock_base += (unsigned long long)(seconds * 1e9);
+  }
+}
+
+
+
+/* Monitors */
+
+static void stub_set_gamma_size(GLFWmonitor *monitor, unsigned int size)
+{
+  free(monitor->ramp.red);
+  free(monitor->ramp.green);
+  free(monitor->ramp.blue);
+  monitor->ramp.red = (unsigned short *)calloc(size, sizeof(unsigned short));
+  monitor->ramp.green = (unsigned short *)calloc(size, sizeof(unsigned short));
+  monitor->ramp.blue = (unsigned short *)calloc(size, sizeof(unsigned short));
+  monitor->ramp.size = size;
+}
+
+static GLFWmonitor *stub_add_monitor(const char *name, int x, int y, const GLFWvidmode *modes, int mode_count)
+{
+  GLFWmonitor *monitor = (GLFWmonitor *)calloc(1, sizeof(GLFWmonitor));
+  const GLFWvidmode *current = &modes[mode_count - 1];
+
+  monitor->name = stub_strdup(name);
+  monitor->connected = 1;
+  monitor->x = x;
+  monitor->y = y;
+  /* Assume roughly 96 DPI */
+  monitor->width_mm = (int)(current->width * 25.4 / 96.0);
+  monitor->height_mm = (int)(current->height * 25.4 / 96.0);
+  monitor->modes = (GLFWvidmode *)malloc(sizeof(GLFWvidmode) * mode_count);
+  memcpy(monitor->modes, modes, sizeof(GLFWvidmode) * mode_count);
+  monitor->mode_count = mode_count;
+  monitor->current_mode = mode_count - 1;
+  stub_set_gamma_size(monitor, 256);
+  glfwSetGamma(monitor, 1.0f);
+
+  monitor->next_allocated = s_allocated_monitors;
+  s_allocated_monitors = monitor;
+
+  s_monitors = (GLFWmonitor **)realloc(s_monitors, sizeof(GLFWmonitor *) * (s_monitor_count + 1));
+  s_monitors[s_monitor_count++] = monitor;
+
+  return monitor;
+}
+
+static void stub_free_monitors(void)
+{
+  while (s_allocated_monitors) {
+    GLFWmonitor *monitor = s_allocated_monitors;
+    s_allocated_monitors = monitor->next_allocated;
+    free(monitor->name);
+    free(monitor->modes);
+    free(monitor->ramp.red);
+    free(monitor->ramp.green);
+    free(monitor->ramp.blue);
+    free(monitor);
+  }
+  free(s_monitors);
+  s_monitors = NULL;
+  s_monitor_count = 0;
+}
+
+GLFWmonitor **glfwGetMonitors(int *count)
+{
+  *count = 0;
+  if (!stub_require_init()) {
+    return NULL;
+  }
+  *count = s_monitor_count;
+  return s_monitors;
+}
+
+GLFWmonitor *glfwGetPrimaryMonitor(void)
+{
+  if (!stub_require_init() || s_monitor_count == 0) {
+    return NULL;
+  }
+  return s_monitors[0];
+}
+
+void glfwGetMonitorPos(GLFWmonitor *monitor, int *xpos, int *ypos)
+{
+  if (xpos) *xpos = monitor->x;
+  if (ypos) *ypos = monitor->y;
+}
+
+void glfwGetMonitorPhysicalSize(GLFWmonitor *monitor, int *width, int *height)
+{
+  if (width) *width = monitor->width_mm;
+  if (height) *height = monitor->height_mm;
+}
+
+const char *glfwGetMonitorName(GLFWmonitor *monitor)
+{
+  return monitor->name;
+}
+
+GLFWmonitorfun glfwSetMonitorCallback(GLFWmonitorfun cbfun)
+{
+  GLFWmonitorfun previous = s_monitor_callback;
+  s_monitor_callback = cbfun;
+  return previous;
+}
+
+const GLFWvidmode *glfwGetVideoModes(GLFWmonitor *monitor, int *count)
+{
+  *count = monitor->mode_count;
+  return monitor->modes;
+}
+
+const GLFWvidmode *glfwGetVideoMode(GLFWmonitor *monitor)
+{
+  return &monitor->modes[monitor->current_mode];
+}
+
+void glfwSetGamma(GLFWmonitor *monitor, float gamma)
+{
+  unsigned int index = 0;
+
+  if (gamma <= 0.0f) {
+    stub_error(GLFW_INVALID_VALUE, "Gamma value must be greater than zero");
+    return;
+  }
+
+  for (; index < monitor->ramp.size; ++index) {
+    double value = pow((double)index / (double)(monitor->ramp.size - 1), 1.0 / gamma) * 65535.0 + 0.5;
+    if (value > 65535.0) {
+      value = 65535.0;
+    }
+    monitor->ramp.red[index] = monitor->ramp.green[index] = monitor->ramp.blue[index] = (unsigned short)value;
+  }
+}
+
+const GLFWgammaramp *glfwGetGammaRamp(GLFWmonitor *monitor)
+{
+  return &monitor->ramp;
+}
+
+void glfwSetGammaRamp(GLFWmonitor *monitor, const GLFWgammaramp *ramp)
+{
+  if (ramp->size != monitor->ramp.size) {
+    stub_set_gamma_size(monitor, ramp->size);
+  }
+  memcpy(monitor->ramp.red, ramp->red, sizeof(unsigned short) * ramp->size);
+  memcpy(monitor->ramp.green, ramp->green, sizeof(unsigned short) * ramp->size);
+  memcpy(monitor->ramp.blue, ramp->blue, sizeof(unsigned short) * ramp->size);
+}
+
+GLFWmonitor *glfwStubConnectMonitor(const char *name, int width, int height, int refresh_rate)
+{
+  GLFWvidmode mode;
+  GLFWmonitor *monitor;
+  int x = 0;
+  int index = 0;
+
+  if (!stub_require_init()) {
+    return NULL;
+  }
+
+  /* Place it to the right of the existing monitors */
+  for (; index < s_monitor_count; ++index) {
+    const GLFWvidmode *current = glfwGetVideoMode(s_monitors[index]);
+    if (s_monitors[index]->x + current->width > x) {
+      x = s_monitors[index]->x + current->width;
+    }
+  }
+
+  mode.width = width;
+  mode.height = height;
+  mode.redBits = mode.greenBits = mode.blueBits = 8;
+  mode.refreshRate = refresh_rate;
+  monitor = stub_add_monitor(name, x, 0, &mode, 1);
+
+  if (s_monitor_callback) {
+    s_monitor_callback(monitor, GLFW_CONNECTED);
+  }
+  return monitor;
+}
+
+void glfwStubDisconnectMonitor(GLFWmonitor *monitor)
+{
+  GLFWwindow *window = s_windows;
+  int index = 0;
+
+  if (!monitor->connected) {
+    return;
+  }
+
+  for (; index < s_monitor_count; ++index) {
+    if (s_monitors[index] == monitor) {
+      memmove(&s_monitors[index], &s_monitors[index + 1], sizeof(GLFWmonitor *) * (s_monitor_count - index - 1));
+      --s_monitor_count;
+      break;
+    }
+  }
+  monitor->connected = 0;
+
+  for (; window; window = window->next) {
+    if (window->monitor == monitor) {
+      window->monitor = NULL;
+    }
+  }
+
+  /* Kept allocated until glfwTerminate, as real GLFW does */
+  if (s_monitor_callback) {
+    s_monitor_callback(monitor, GLFW_DISCONNECTED);
+  }
+}
+
+
+
+/* Joysticks */
+
+static void stub_clear_joystick(stub_joystick_t *joystick)
+{
+  free(joystick->name);
+  free(joystick->axes);
+  free(joystick->buttons);
+  memset(joystick, 0, sizeof(*joystick));
+}
+
+static stub_joystick_t *stub_joystick(int joy)
+{
+  if (joy < GLFW_JOYSTICK_1 || joy > GLFW_JOYSTICK_LAST) {
+    stub_error(GLFW_INVALID_ENUM, "Invalid joystick");
+    return NULL;
+  }
+  return &s_joysticks[joy];
+}
+
+int glfwJoystickPresent(int joy)
+{
+  stub_joystick_t *joystick = stub_joystick(joy);
+  return joystick && joystick->name ? GL_TRUE : GL_FALSE;
+}
+
+const float *glfwGetJoystickAxes(int joy, int *count)
+{
+  stub_joystick_t *joystick = stub_joystick(joy);
+  *count = 0;
+  if (joystick == NULL || joystick->name == NULL) {
+    return NULL;
+  }
+  *count = joystick->axis_count;
+  return joystick->axes;
+}
+
+const unsigned char *glfwGetJoystickButtons(int joy, int *count)
+{
+  stub_joystick_t *joystick = stub_joystick(joy);
+  *count = 0;
+  if (joystick == NULL || joystick->name == NULL) {
+    return NULL;
+  }
+  *count = joystick->button_count;
+  return joystick->buttons;
+}
+
+const char *glfwGetJoystickName(int joy)
+{
+  stub_joystick_t *joystick = stub_joystick(joy);
+  return joystick ? joystick->name : NULL;
+}
+
+void glfwStubSetJoystick(int joy, const char *name, const float *axes, int axis_count,
+                         const unsigned char *buttons, int button_count)
+{
+  stub_joystick_t *joystick = stub_joystick(joy);
+  if (joystick == NULL) {
+    return;
+  }
+
+  stub_clear_joystick(joystick);
+  if (name == NULL) {
+    return;
+  }
+
+  joystick->name = stub_strdup(name);
+  joystick->axes = (float *)calloc(axis_count ? axis_count : 1, sizeof(float));
+  joystick->buttons = (unsigned char *)calloc(button_count ? button_count : 1, 1);
+  memcpy(joystick->axes, axes, sizeof(float) * axis_count);
+  memcpy(joystick->buttons, buttons, button_count);
+  joystick->axis_count = axis_count;
+  joystick->button_count = button_count;
+}
+
+
+
+/* Events */
+
+/* Makes the event pipe readable exactly while events are queued */
+static void stub_update_event_signal(void)
+{
+#ifndef _WIN32
+  char byte = 0;
+
+  if (s_event_pipe[0] < 0) {
+    return;
+  }
+
+  if (s_event_count > 0 && !s_event_signalled) {
+    s_event_signalled = write(s_event_pipe[1], &byte, 1) == 1;
+  } else if (s_event_count == 0 && s_event_signalled) {
+    s_event_signalled = read(s_event_pipe[0], &byte, 1) != 1;
+  }
+#endif
+}
+
+int glfwStubEventFd(void)
+{
+  return s_event_pipe[0];
+}
+
+void glfwStubPostEvent(const GLFWstubevent *event)
+{
+  if (s_event_count == s_event_capacity) {
+    int capacity = s_event_capacity ? s_event_capacity * 2 : 64;
+    GLFWstubevent *events = (GLFWstubevent *)malloc(sizeof(GLFWstubevent) * capacity);
+    int index = 0;
+    for (; index < s_event_count; ++index) {
+      events[index] = s_events[(s_event_head + index) % s_event_capacity];
+    }
+    free(s_events);
+    s_events = events;
+    s_event_head = 0;
+    s_event_capacity = capacity;
+  }
+
+  s_events[(s_event_head + s_event_count) % s_event_capacity] = *event;
+  ++s_event_count;
+  stub_update_event_signal();
+}
+
+int glfwStubPendingEvents(void)
+{
+  return s_event_count;
+}
+
+static void stub_post(GLFWwindow *window, int type, int a, int b)
+{
+  GLFWstubevent event;
+  memset(&event, 0, sizeof(event));
+  event.type = type;
+  event.window = window;
+  event.i[0] = a;
+  event.i[1] = b;
+  glfwStubPostEvent(&event);
+}
+
+/* Whether window hasn't been destroyed, e.g. by one of its own callbacks. */
+static int stub_window_alive(GLFWwindow *window)
+{
+  GLFWwindow *live = s_windows;
+  for (; live; live = live->next) {
+    if (live == window) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static void stub_deliver(const GLFWstubevent *event)
+{
+  GLFWwindow *window = event->window;
+  const int *i = event->i;
+
+  switch (event->type) {
+  case GLFW_STUB_EVENT_KEY:
+    if (i[0] >= 0 && i[0] <= GLFW_KEY_LAST) {
+      if (i[2] == GLFW_RELEASE && window->sticky_keys) {
+        window->keys[i[0]] = STUB_STICK;
+      } else {
+        window->keys[i[0]] = (char)(i[2] == GLFW_RELEASE ? GLFW_RELEASE : GLFW_PRESS);
+      }
+    }
+    if (window->key_callback) window->key_callback(window, i[0], i[1], i[2], i[3]);
+    break;
+  case GLFW_STUB_EVENT_CHAR:
+    if (window->char_callback) window->char_callback(window, (unsigned int)i[0]);
+    break;
+  case GLFW_STUB_EVENT_MOUSE_BUTTON:
+    if (i[0] >= 0 && i[0] <= GLFW_MOUSE_BUTTON_LAST) {
+      if (i[1] == GLFW_RELEASE && window->sticky_mouse_buttons) {
+        window->mouse_buttons[i[0]] = STUB_STICK;
+      } else {
+        window->mouse_buttons[i[0]] = (char)i[1];
+      }
+    }
+    if (window->mouse_button_callback) window->mouse_button_callback(window, i[0], i[1], i[2]);
+    break;
+  case GLFW_STUB_EVENT_CURSOR_POS:
+    window->cursor_x = event->d[0];
+    window->cursor_y = event->d[1];
+    if (window->cursor_pos_callback) window->cursor_pos_callback(window, event->d[0], event->d[1]);
+    break;
+  case GLFW_STUB_EVENT_CURSOR_ENTER:
+    if (window->cursor_enter_callback) window->cursor_enter_callback(window, i[0]);
+    break;
+  case GLFW_STUB_EVENT_SCROLL:
+    if (window->scroll_callback) window->scroll_callback(window, event->d[0], event->d[1]);
+    break;
+  case GLFW_STUB_EVENT_WINDOW_POS:
+    window->x = i[0];
+    window->y = i[1];
+    if (window->pos_callback) window->pos_callback(window, i[0], i[1]);
+    break;
+  case GLFW_STUB_EVENT_WINDOW_SIZE:
+    window->width = window->fb_width = i[0];
+    window->height = window->fb_height = i[1];
+    if (window->size_callback) window->size_callback(window, i[0], i[1]);
+    if (stub_window_alive(window) && window->fbsize_callback) window->fbsize_callback(window, i[0], i[1]);
+    break;
+  case GLFW_STUB_EVENT_WINDOW_CLOSE:
+    window->should_close = GL_TRUE;
+    if (window->close_callback) window->close_callback(window);
+    break;
+  case GLFW_STUB_EVENT_WINDOW_REFRESH:
+    if (window->refresh_callback) window->refresh_callback(window);
+    break;
+  case GLFW_STUB_EVENT_WINDOW_FOCUS:
+    window->focused = i[0] ? GL_TRUE : GL_FALSE;
+    if (window->focus_callback) window->focus_callback(window, window->focused);
+    break;
+  case GLFW_STUB_EVENT_WINDOW_ICONIFY:
+    window->iconified = i[0] ? GL_TRUE : GL_FALSE;
+    if (window->iconify_callback) window->iconify_callback(window, window->iconified);
+    break;
+  case GLFW_STUB_EVENT_FRAMEBUFFER_SIZE:
+    window->fb_width = i[0];
+    window->fb_height = i[1];
+    if (window->fbsize_callback) window->fbsize_callback(window, i[0], i[1]);
+    break;
+  default:
+    stub_error(GLFW_INVALID_ENUM, "Invalid stub event type");
+    break;
+  }
+}
+
+/*
+ * Delivers the events queued so far. Events posted by callbacks while this
+ * runs wait for the next call, so a callback that posts can't loop forever.
+ */
+void glfwPollEvents(void)
+{
+  int remaining = s_event_count;
+
+  if (!stub_require_init()) {
+    return;
+  }
+
+  while (remaining-- > 0 && s_event_count > 0) {
+    GLFWstubevent event = s_events[s_event_head];
+    s_event_head = (s_event_head + 1) % s_event_capacity;
+    --s_event_count;
+    /* Events for destroyed windows have their window cleared */
+    if (event.window) {
+      stub_deliver(&event);
+    }
+  }
+
+  stub_update_event_signal();
+}
+
+void glfwWaitEvents(void)
+{
+  glfwPollEvents();
+}
+
+
+
+/* Windows */
+
+static void stub_default_hints(void)
+{
+  memset(&s_hints, 0, sizeof(s_hints));
+  s_hints.resizable = GL_TRUE;
+  s_hints.visible = GL_TRUE;
+  s_hints.decorated = GL_TRUE;
+  s_hints.red_bits = s_hints.green_bits = s_hints.blue_bits = s_hints.alpha_bits = 8;
+  s_hints.depth_bits = 24;
+  s_hints.stencil_bits = 8;
+  s_hints.client_api = GLFW_OPENGL_API;
+  s_hints.context_major = 1;
+  s_hints.context_minor = 0;
+  s_hints.context_robustness = GLFW_NO_ROBUSTNESS;
+  s_hints.profile = GLFW_OPENGL_ANY_PROFILE;
+}
+
+void glfwDefaultWindowHints(void)
+{
+  stub_default_hints();
+}
+
+void glfwWindowHint(int target, int hint)
+{
+  switch (target) {
+  case GLFW_RESIZABLE:              s_hints.resizable = hint; break;
+  case GLFW_VISIBLE:                s_hints.visible = hint; break;
+  case GLFW_DECORATED:              s_hints.decorated = hint; break;
+  case GLFW_RED_BITS:               s_hints.red_bits = hint; break;
+  case GLFW_GREEN_BITS:             s_hints.green_bits = hint; break;
+  case GLFW_BLUE_BITS:              s_hints.blue_bits = hint; break;
+  case GLFW_ALPHA_BITS:             s_hints.alpha_bits = hint; break;
+  case GLFW_DEPTH_BITS:             s_hints.depth_bits = hint; break;
+  case GLFW_STENCIL_BITS:           s_hints.stencil_bits = hint; break;
+  case GLFW_SAMPLES:                s_hints.samples = hint; break;
+  case GLFW_REFRESH_RATE:           s_hints.refresh_rate = hint; break;
+  case GLFW_CLIENT_API:             s_hints.client_api = hint; break;
+  case GLFW_CONTEXT_VERSION_MAJOR:  s_hints.context_major = hint; break;
+  case GLFW_CONTEXT_VERSION_MINOR:  s_hints.context_minor = hint; break;
+  case GLFW_CONTEXT_ROBUSTNESS:     s_hints.context_robustness = hint; break;
+  case GLFW_OPENGL_FORWARD_COMPAT:  s_hints.forward_compat = hint; break;
+  case GLFW_OPENGL_DEBUG_CONTEXT:   s_hints.debug_context = hint; break;
+  case GLFW_OPENGL_PROFILE:         s_hints.profile = hint; break;
+  /* Accepted and ignored, as with framebuffer hints GLFW can't honor */
+  case GLFW_ACCUM_RED_BITS:
+  case GLFW_ACCUM_GREEN_BITS:
+  case GLFW_ACCUM_BLUE_BITS:
+  case GLFW_ACCUM_ALPHA_BITS:
+  case GLFW_AUX_BUFFERS:
+  case GLFW_STEREO:
+  case GLFW_SRGB_CAPABLE:
+    break;
+  default:
+    stub_error(GLFW_INVALID_ENUM, "Invalid window hint");
+    break;
+  }
+}
+
+GLFWwindow *glfwCreateWindow(int width, int height, const char *title, GLFWmonitor *monitor, GLFWwindow *share)
+{
+  GLFWwindow *window;
+
+  if (!stub_require_init()) {
+    return NULL;
+  }
+  if (width <= 0 || height <= 0) {
+    stub_error(GLFW_INVALID_VALUE, "Invalid window size");
+    return NULL;
+  }
+
+  window = (GLFWwindow *)calloc(1, sizeof(GLFWwindow));
+  window->hints = s_hints;
+  window->title = stub_strdup(title);
+  window->monitor = monitor;
+  window->width = window->fb_width = width;
+  window->height = window->fb_height = height;
+  window->visible = monitor ? GL_TRUE : s_hints.visible;
+  window->focused = window->visible;
+  window->cursor_mode = GLFW_CURSOR_NORMAL;
+  if (monitor) {
+    window->x = monitor->x;
+    window->y = monitor->y;
+  }
+
+  window->next = s_windows;
+  s_windows = window;
+  return window;
+}
+
+void glfwDestroyWindow(GLFWwindow *window)
+{
+  GLFWwindow **link = &s_windows;
+  int index = 0;
+
+  if (window == NULL) {
+    return;
+  }
+
+  while (*link && *link != window) {
+    link = &(*link)->next;
+  }
+  if (*link) {
+    *link = window->next;
+  }
+
+  for (; index < s_event_count; ++index) {
+    GLFWstubevent *event = &s_events[(s_event_head + index) % s_event_capacity];
+    if (event->window == window) {
+      event->window = NULL;
+    }
+  }
+
+  if (s_current_context == window) {
+    s_current_context = NULL;
+  }
+
+  free(window->title);
+  free(window);
+}
+
+int glfwWindowShouldClose(GLFWwindow *window)
+{
+  return window->should_close;
+}
+
+void glfwSetWindowShouldClose(GLFWwindow *window, int value)
+{
+  window->should_close = value;
+}
+
+void glfwSetWindowTitle(GLFWwindow *window, const char *title)
+{
+  free(window->title);
+  window->title = stub_strdup(title);
+}
+
+void glfwGetWindowPos(GLFWwindow *window, int *xpos, int *ypos)
+{
+  if (xpos) *xpos = window->x;
+  if (ypos) *ypos = window->y;
+}
+
+void glfwSetWindowPos(GLFWwindow *window, int xpos, int ypos)
+{
+  if (window->monitor == NULL) {
+    stub_post(window, GLFW_STUB_EVENT_WINDOW_POS, xpos, ypos);
+  }
+}
+
+void glfwGetWindowSize(GLFWwindow *window, int *width, int *height)
+{
+  if (width) *width = window->width;
+  if (height) *height = window->height;
+}
+
+void glfwSetWindowSize(GLFWwindow *window, int width, int height)
+{
+  stub_post(window, GLFW_STUB_EVENT_WINDOW_SIZE, width, height);
+}
+
+void glfwGetFramebufferSize(GLFWwindow *window, int *width, int *height)
+{
+  if (width) *width = window->fb_width;
+  if (height) *height = window->fb_height;
+}
+
+void glfwIconifyWindow(GLFWwindow *window)
+{
+  if (!window->iconified) {
+    stub_post(window, GLFW_STUB_EVENT_WINDOW_ICONIFY, GL_TRUE, 0);
+  }
+}
+
+void glfwRestoreWindow(GLFWwindow *window)
+{
+  if (window->iconified) {
+    stub_post(window, GLFW_STUB_EVENT_WINDOW_ICONIFY, GL_FALSE, 0);
+  }
+}
+
+void glfwShowWindow(GLFWwindow *window)
+{
+  window->visible = GL_TRUE;
+}
+
+void glfwHideWindow(GLFWwindow *window)
+{
+  window->visible = GL_FALSE;
+}
+
+GLFWmonitor *glfwGetWindowMonitor(GLFWwindow *window)
+{
+  return window->monitor;
+}
+
+int glfwGetWindowAttrib(GLFWwindow *window, int attrib)
+{
+  switch (attrib) {
+  case GLFW_FOCUSED:                return window->focused;
+  case GLFW_ICONIFIED:              return window->iconified;
+  case GLFW_VISIBLE:                return window->visible;
+  case GLFW_RESIZABLE:              return window->hints.resizable;
+  case GLFW_DECORATED:              return window->hints.decorated;
+  case GLFW_CLIENT_API:             return window->hints.client_api;
+  case GLFW_CONTEXT_VERSION_MAJOR:  return window->hints.context_major;
+  case GLFW_CONTEXT_VERSION_MINOR:  return window->hints.context_minor;
+  case GLFW_CONTEXT_REVISION:       return 0;
+  case GLFW_CONTEXT_ROBUSTNESS:     return window->hints.context_robustness;
+  case GLFW_OPENGL_FORWARD_COMPAT:  return window->hints.forward_compat;
+  case GLFW_OPENGL_DEBUG_CONTEXT:   return window->hints.debug_context;
+  case GLFW_OPENGL_PROFILE:         return window->hints.profile;
+  default:
+    stub_error(GLFW_INVALID_ENUM, "Invalid window attribute");
+    return 0;
+  }
+}
+
+void glfwSetWindowUserPointer(GLFWwindow *window, void *pointer)
+{
+  window->user_pointer = pointer;
+}
+
+void *glfwGetWindowUserPointer(GLFWwindow *window)
+{
+  return window->user_pointer;
+}
+
+#define STUB_CALLBACK_SETTER(NAME, TYPE, FIELD)                               \
+TYPE NAME(GLFWwindow *window, TYPE cbfun)                                     \
+{                                                                             \
+  TYPE previous = window->FIELD;                                              \
+  window->FIELD = cbfun;                                                      \
+  return previous;                                                            \
+}
+
+STUB_CALLBACK_SETTER(glfwSetWindowPosCallback, GLFWwindowposfun, pos_callback)
+STUB_CALLBACK_SETTER(glfwSetWindowSizeCallback, GLFWwindowsizefun, size_callback)
+STUB_CALLBACK_SETTER(glfwSetWindowCloseCallback, GLFWwindowclosefun, close_callback)
+STUB_CALLBACK_SETTER(glfwSetWindowRefreshCallback, GLFWwindowrefreshfun, refresh_callback)
+STUB_CALLBACK_SETTER(glfwSetWindowFocusCallback, GLFWwindowfocusfun, focus_callback)
+STUB_CALLBACK_SETTER(glfwSetWindowIconifyCallback, GLFWwindowiconifyfun, iconify_callback)
+STUB_CALLBACK_SETTER(glfwSetFramebufferSizeCallback, GLFWframebuffersizefun, fbsize_callback)
+STUB_CALLBACK_SETTER(glfwSetKeyCallback, GLFWkeyfun, key_callback)
+STUB_CALLBACK_SETTER(glfwSetCharCallback, GLFWcharfun, char_callback)
+STUB_CALLBACK_SETTER(glfwSetMouseButtonCallback, GLFWmousebuttonfun, mouse_button_callback)
+STUB_CALLBACK_SETTER(glfwSetCursorPosCallback, GLFWcursorposfun, cursor_pos_callback)
+STUB_CALLBACK_SETTER(glfwSetCursorEnterCallback, GLFWcursorenterfun, cursor_enter_callback)
+STUB_CALLBACK_SETTER(glfwSetScrollCallback, GLFWscrollfun, scroll_callback)
+
+unsigned long glfwStubSwapCount(GLFWwindow *window)
+{
+  return window->swap_count;
+}
+
+
+
+/* Input */
+
+int glfwGetInputMode(GLFWwindow *window, int mode)
+{
+  switch (mode) {
+  case GLFW_CURSOR:               return window->cursor_mode;
+  case GLFW_STICKY_KEYS:          return window->sticky_keys;
+  case GLFW_STICKY_MOUSE_BUTTONS: return window->sticky_mouse_buttons;
+  default:
+    stub_error(GLFW_INVALID_ENUM, "Invalid input mode");
+    return 0;
+  }
+}
+
+static void stub_unstick(char *states, int count)
+{
+  int index = 0;
+  for (; index < count; ++index) {
+    if (states[index] == STUB_STICK) {
+      states[index] = GLFW_RELEASE;
+    }
+  }
+}
+
+void glfwSetInputMode(GLFWwindow *window, int mode, int value)
+{
+  switch (mode) {
+  case GLFW_CURSOR:
+    window->cursor_mode = value;
+    break;
+  case GLFW_STICKY_KEYS:
+    window->sticky_keys = value ? GL_TRUE : GL_FALSE;
+    if (!value) {
+      stub_unstick(window->keys, GLFW_KEY_LAST + 1);
+    }
+    break;
+  case GLFW_STICKY_MOUSE_BUTTONS:
+    window->sticky_mouse_buttons = value ? GL_TRUE : GL_FALSE;
+    if (!value) {
+      stub_unstick(window->mouse_buttons, GLFW_MOUSE_BUTTON_LAST + 1);
+    }
+    break;
+  default:
+    stub_error(GLFW_INVALID_ENUM, "Invalid input mode");
+    break;
+  }
+}
+
+int glfwGetKey(GLFWwindow *window, int key)
+{
+  if (key < 0 || key > GLFW_KEY_LAST) {
+    stub_error(GLFW_INVALID_ENUM, "Invalid key");
+    return GLFW_RELEASE;
+  }
+  if (window->keys[key] == STUB_STICK) {
+    window->keys[key] = GLFW_RELEASE;
+    return GLFW_PRESS;
+  }
+  return window->keys[key];
+}
+
+int glfwGetMouseButton(GLFWwindow *window, int button)
+{
+  if (button < 0 || button > GLFW_MOUSE_BUTTON_LAST) {
+    stub_error(GLFW_INVALID_ENUM, "Invalid mouse button");
+    return GLFW_RELEASE;
+  }
+  if (window->mouse_buttons[button] == STUB_STICK) {
+    window->mouse_buttons[button] = GLFW_RELEASE;
+    return GLFW_PRESS;
+  }
+  return window->mouse_buttons[button];
+}
+
+void glfwGetCursorPos(GLFWwindow *window, double *xpos, double *ypos)
+{
+  if (xpos) *xpos = window->cursor_x;
+  if (ypos) *ypos = window->cursor_y;
+}
+
+void glfwSetCursorPos(GLFWwindow *window, double xpos, double ypos)
+{
+  window->cursor_x = xpos;
+  window->cursor_y = ypos;
+}
+
+void glfwSetClipboardString(GLFWwindow *window, const char *string)
+{
+  free(s_clipboard);
+  s_clipboard = stub_strdup(string);
+}
+
+const char *glfwGetClipboardString(GLFWwindow *window)
+{
+  if (s_clipboard == NULL) {
+    stub_error(GLFW_FORMAT_UNAVAILABLE, "The clipboard is empty");
+  }
+  return s_clipboard;
+}
+
+
+
+/* Context */
+
+void glfwMakeContextCurrent(GLFWwindow *window)
+{
+  s_current_context = window;
+}
+
+GLFWwindow *glfwGetCurrentContext(void)
+{
+  return s_current_context;
+}
+
+void glfwSwapBuffers(GLFWwindow *window)
+{
+  if (s_strict_swap && window != s_current_context) {
+    stub_error(GLFW_PLATFORM_ERROR, "The context must be current on the calling thread when swapping buffers");
+    return;
+  }
+  window->swap_count += 1;
+}
+
+void glfwStubSetStrictSwap(int strict)
+{
+  s_strict_swap = strict;
+}
+
+void glfwSwapInterval(int interval)
+{
+  if (s_current_context == NULL) {
+    stub_error(GLFW_NO_CURRENT_CONTEXT, "No context is current");
+  }
+}
+
+int glfwExtensionSupported(const char *extension)
+{
+  if (s_current_context == NULL) {
+    stub_error(GLFW_NO_CURRENT_CONTEXT, "No context is current");
+  }
+  return GL_FALSE;
+}
+
+GLFWglproc glfwGetProcAddress(const char *procname)
+{
+  return NULL;
+}
+
+
+
+/* Library */
+
+int glfwInit(void)
+{
+  static const GLFWvidmode primary_modes[] = {
+    { 640, 480, 8, 8, 8, 60 },
+    { 1280, 720, 8, 8, 8, 60 },
+    { 1920, 1080, 8, 8, 8, 60 }
+  };
+  static const GLFWvidmode secondary_modes[] = {
+    { 1024, 768, 8, 8, 8, 75 },
+    { 1280, 1024, 8, 8, 8, 75 }
+  };
+
+  if (s_initialized) {
+    return GL_TRUE;
+  }
+
+  s_initialized = 1;
+#ifndef _WIN32
+  if (pipe(s_event_pipe) != 0) {
+    s_event_pipe[0] = s_event_pipe[1] = -1;
+  }
+#endif
+  stub_default_hints();
+  stub_add_monitor("Stub Primary", 0, 0, primary_modes, 3);
+  stub_add_monitor("Stub Secondary", 1920, 0, secondary_modes, 2);
+  glfwSetTime(0.0);
+
+  return GL_TRUE;
+}
+
+void glfwTerminate(void)
+{
+  int joy = 0;
+
+  if (!s_initialized) {
+    return;
+  }
+
+  while (s_windows) {
+    glfwDestroyWindow(s_windows);
+  }
+  stub_free_monitors();
+  for (; joy <= GLFW_JOYSTICK_LAST; ++joy) {
+    stub_clear_joystick(&s_joysticks[joy]);
+  }
+  free(s_clipboard);
+  s_clipboard = NULL;
+  free(s_events);
+  s_events = NULL;
+  s_event_head = s_event_count = s_event_capacity = 0;
+#ifndef _WIN32
+  if (s_event_pipe[0] >= 0) {
+    close(s_event_pipe[0]);
+    close(s_event_pipe[1]);
+  }
+#endif
+  s_event_pipe[0] = s_event_pipe[1] = -1;
+  s_event_signalled = 0;
+  s_initialized = 0;
+}
+
+void glfwGetVersion(int *major, int *minor, int *rev)
+{
+  if (major) *major = GLFW_VERSION_MAJOR;
+  if (minor) *minor = GLFW_VERSION_MINOR;
+  if (rev) *rev = GLFW_VERSION_REVISION;
+}
+
+const char *glfwGetVersionString(void)
+{
+  return "3.0.4 Stub";
+}
+
+GLFWerrorfun glfwSetErrorCallback(GLFWerrorfun cbfun)
+{
+  GLFWerrorfun previous = s_error_callback;
+  s_error_callback = cbfun;
+  return previous;
+}
@@ -2,12 +2,13 @@ require 'glfw3/glfw3'
 require 'glfw3/callbacks'
 require 'glfw3/monitor'
 require 'glfw3/window'
+require 'glfw3/worker_pool'
 
 #
 # The core Glfw module, contains functions for setting error and monitor
 # callbacks, joystick input, constants, timing, event handling, and so on.
 #
-# See also Glfw::Window, Glfw::Monitor, and Glfw::VideoMode.
+# See also Glfw::Window, Glfw::Monitor, Glfw::VideoMode, and Glfw::WorkerPool.
 #
 module Glfw
 end
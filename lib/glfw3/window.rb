@@ -25,6 +25,17 @@ module Glfw; end
 # the window. If you need to store multiple values with the window, you might
 # set its user data object to a Hash.
 #
+#
+# === Cached State
+#
+# Each window keeps a native copy of its position, size, framebuffer size,
+# focus, and iconify state, updated whenever the window system reports a
+# change. #x, #y, #width, #height, #framebuffer_width, #framebuffer_height,
+# #focused?, and #iconified? read from that copy, so they're cheap enough to
+# call as often as you like. Changes you make yourself (e.g., via #set_size)
+# show up after the next Glfw::poll_events, or immediately after a call to
+# #refresh_cache.
+#
 class Glfw::Window
 
   #
@@ -39,6 +50,7 @@ class Glfw::Window
   alias_method :should_close=, :set_should_close
 
   alias_method :cursor_pos, :get_cursor_pos
+  alias_method :cursor_pos_into, :get_cursor_pos_into
 
   def cursor_pos=(xy)
     set_cursor_pos(*xy)
@@ -49,6 +61,8 @@ class Glfw::Window
 
   alias_method :position, :get_position
   alias_method :size, :get_size
+  alias_method :position_into, :get_position_into
+  alias_method :size_into, :get_size_into
 
   def position=(xy)
     set_position(*xy)
@@ -68,34 +82,6 @@ class Glfw::Window
     @@__windows.values
   end
 
-  #
-  # Gets the X position of the window in screen space. See also #position.
-  #
-  def x
-    position[0]
-  end
-
-  #
-  # Gets the Y position of the window in screen space. See also #position.
-  #
-  def y
-    position[1]
-  end
-
-  #
-  # Gets the width of the window. See also #size.
-  #
-  def width
-    size[0]
-  end
-
-  #
-  # Gets the width of the window. See also #size.
-  #
-  def height
-    size[1]
-  end
-
   def key_callback=(func)
     @__key_callback = func
     set_key_callback__(func.respond_to?(:call))
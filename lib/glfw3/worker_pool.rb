@@ -0,0 +1,155 @@
+require 'glfw3/glfw3'
+require 'thread'
+
+module Glfw ; end
+
+#
+# A pool of worker threads, each with the context of its own hidden window
+# current. The windows share objects with a given window's context, so
+# textures, buffers, and so on created or filled by a worker can be used for
+# rendering, letting uploads overlap drawing instead of stalling it.
+#
+# Jobs are run in the order posted by whichever worker is free. Once a job's
+# done, its result is handed back on the main thread via Glfw::post_to_main,
+# so it's delivered by the main thread's next Glfw::poll_events (or similar),
+# which also wakes it if it's waiting for events.
+#
+# A job should finish its GL work (e.g., with glFinish or a fence) before
+# returning, so the objects it made are ready once the main thread uses them.
+#
+# For example:
+#
+#     pool = Glfw::WorkerPool.new(window, size: 2)
+#
+#     pool.post(lambda { |texture| textures[path] = texture }) {
+#       texture = upload_texture(load_image(path))
+#       GL.glFinish
+#       texture
+#     }
+#
+#     # Later, on the main thread:
+#     pool.shutdown
+#
+class Glfw::WorkerPool
+
+  # The window whose context the workers' contexts share objects with.
+  attr_reader :share
+
+  #
+  # Creates +size+ hidden windows sharing +share+'s context, and a worker
+  # thread for each. Must be called on the main thread, like Glfw::Window.new.
+  # The windows are created with the hints share was created with (see
+  # Glfw::Window#hint_preset), except that they're invisible, so their contexts
+  # are compatible with share's. The current window hints are left alone.
+  #
+  # If the window pool is enabled (see Glfw::Window.pool_limit=), the windows
+  # may be recycled ones, whose contexts keep whatever GL state was left in
+  # them, such as bound objects. Jobs shouldn't rely on a fresh context's
+  # state.
+  #
+  # Raises RuntimeError if a window can't be created, after destroying the
+  # windows already created.
+  #
+  # call-seq:
+  #     new(share, size: 2) -> worker_pool
+  #
+  def initialize(share, size: 2)
+    raise ArgumentError, "size must be greater than zero" unless size > 0
+
+    @share = share
+    @jobs = Queue.new
+    @pending = 0
+    @lock = Mutex.new
+
+    hints = Glfw::Window::HintPreset.new(share.hint_preset.to_h.merge(Glfw::VISIBLE => false))
+    @windows = []
+    begin
+      size.times { |index|
+        window = Glfw::Window.new(1, 1, "worker #{index}", nil, share, hints)
+        raise RuntimeError, "unable to create worker window #{index}" if window.nil?
+        @windows << window
+      }
+    rescue Exception
+      @windows.each(&:destroy)
+      raise
+    end
+
+    @threads = @windows.map { |window| Thread.new(window) { |context| work(context) } }
+  end
+
+  #
+  # Returns the number of workers.
+  #
+  def size
+    @windows.length
+  end
+
+  #
+  # Returns the number of jobs posted that haven't finished yet.
+  #
+  def pending
+    @lock.synchronize { @pending }
+  end
+
+  #
+  # Queues the block to run on a worker with the worker's context current.
+  # If +on_complete+ is given, it's called on the main thread with the block's
+  # result. If the block raises an exception, it's raised on the main thread
+  # instead, from the call that runs posted work (see Glfw::post_to_main).
+  # Can be called from any thread.
+  #
+  # call-seq:
+  #     post(on_complete = nil) { ... } -> self
+  #
+  def post(on_complete = nil, &job)
+    raise ArgumentError, "no block given" unless job
+    raise RuntimeError, "worker pool has been shut down" if @windows.nil?
+
+    @lock.synchronize { @pending += 1 }
+    @jobs << [job, on_complete]
+    self
+  end
+
+  #
+  # Waits for posted jobs to finish, stops the workers, and destroys their
+  # windows. Completions not yet delivered are still delivered by the main
+  # thread's next poll. Must be called on the main thread.
+  #
+  # call-seq:
+  #     shutdown -> self
+  #
+  def shutdown
+    return self if @windows.nil?
+
+    @threads.each { @jobs << nil }
+    @threads.each(&:join)
+    @windows.each(&:destroy)
+    @threads = @windows = nil
+    self
+  end
+
+
+  private
+
+  def work(context)
+    context.make_context_current
+    while (job = @jobs.pop)
+      run(*job)
+    end
+  ensure
+    Glfw::Window.unset_context
+  end
+
+  def run(job, on_complete)
+    begin
+      result = job.call
+    rescue Exception => error
+      Glfw.post_to_main { raise error }
+    else
+      Glfw.post_to_main { on_complete.call(result) } if on_complete
+    ensure
+      @lock.synchronize { @pending -= 1 }
+    end
+  end
+
+end